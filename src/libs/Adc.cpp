@@ -24,6 +24,8 @@ Adc::Adc(){
 // Enables ADC on a given pin
 void Adc::enable_pin(Pin* pin){
     PinName pin_name = this->_pin_to_pinname(pin);
+    // Already sampled, modules call this again when they reload their config
+    if( this->adc->interrupt_state(pin_name) ){ return; }
     this->adc->burst(1);
     this->adc->setup(pin_name,1);
     this->adc->interrupt_state(pin_name,1);
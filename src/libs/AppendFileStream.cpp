@@ -1,12 +1,112 @@
 #include "AppendFileStream.h"
+#include "FilePath.h"
+#include "us_ticker_api.h"
 #include "stdio.h"
 
+AppendFileStream::AppendFileStream(const char *filename)
+{
+    this->fn = strdup(filename);
+    this->handle = NULL;
+    this->used = 0;
+    this->room = APPEND_BUFFER_SIZE;
+    this->unsynced = 0;
+    this->dirty_since = 0;
+    this->dirty = false;
+    this->failed = false;
+}
+
+AppendFileStream::~AppendFileStream()
+{
+    this->close();
+    free(this->fn);
+}
+
+// The file is opened on the first write, through the filesystem's FileHandle rather than stdio so it can be synced
+bool AppendFileStream::open()
+{
+    if(this->handle != NULL) return true;
+    if(this->failed) return false;
+
+    mbed::FilePath path(this->fn);
+    if(path.isFileSystem()) this->handle = path.fileSystem()->open(path.fileName(), O_WRONLY | O_CREAT | O_APPEND);
+    if(this->handle == NULL) {
+        this->failed = true;
+        return false;
+    }
+
+    // Line the buffer up with the sectors of the file
+    this->room = APPEND_BUFFER_SIZE - (this->handle->flen() % APPEND_BUFFER_SIZE);
+    return true;
+}
+
 int AppendFileStream::puts(const char *str)
 {
-    FILE *fd= fopen(this->fn, "a");
-    if(fd == NULL) return 0;
+    if(!this->open()) return 0;
+
+    size_t n = strlen(str);
+    size_t left = n;
+    while(left > 0) {
+        size_t chunk = left < this->room - this->used ? left : this->room - this->used;
+        memcpy(this->buffer + this->used, str, chunk);
+        this->used += chunk;
+        str += chunk;
+        left -= chunk;
+        if(!this->dirty) {
+            this->dirty = true;
+            this->dirty_since = us_ticker_read();
+        }
+        if(this->used == this->room && !this->write_buffer()) return 0;
+    }
 
-    int n= fwrite(str, 1, strlen(str), fd);
-    fclose(fd);
+    if(this->unsynced >= APPEND_SYNC_SIZE) this->flush();
     return n;
 }
+
+// Hand the buffer to FatFs, a whole sector at a time except when flushing
+bool AppendFileStream::write_buffer()
+{
+    if(this->used == 0) return true;
+    if(this->handle->write(this->buffer, this->used) != (ssize_t)this->used) {
+        this->failed = true;
+        this->close();
+        return false;
+    }
+    this->unsynced += this->used;
+    this->room -= this->used;
+    if(this->room == 0) this->room = APPEND_BUFFER_SIZE;
+    this->used = 0;
+    return true;
+}
+
+// Commit everything to the card : data, file size and FAT
+bool AppendFileStream::flush()
+{
+    if(this->handle == NULL) return !this->failed;
+    if(!this->write_buffer()) return false;
+    if(this->unsynced > 0 && this->handle->fsync() != 0) {
+        this->failed = true;
+        this->close();
+        return false;
+    }
+    this->unsynced = 0;
+    this->dirty = false;
+    return true;
+}
+
+// Commit data that has been waiting for longer than APPEND_SYNC_MS, meant to be called from on_idle or on_main_loop
+void AppendFileStream::idle()
+{
+    if(this->dirty && (us_ticker_read() - this->dirty_since) >= APPEND_SYNC_MS * 1000) this->flush();
+}
+
+void AppendFileStream::close()
+{
+    if(this->handle == NULL) return;
+    if(!this->failed) this->flush();
+    if(this->handle == NULL) return;
+    this->handle->close();
+    this->handle = NULL;
+    this->used = 0;
+    this->unsynced = 0;
+    this->dirty = false;
+}
@@ -4,15 +4,42 @@
 #include "StreamOutput.h"
 #include "string.h"
 #include "stdlib.h"
+#include "stdint.h"
 
+namespace mbed { class FileHandle; }
+
+// One sector : the buffer is only written out when it completes a sector of the file, so FatFs never has to read one back
+#define APPEND_BUFFER_SIZE  512
+// One cluster on most cards : the file size and FAT are committed this often at most, unless the data gets stale
+#define APPEND_SYNC_SIZE    4096
+// How long written data may wait in RAM before it is committed, see idle()
+#define APPEND_SYNC_MS      2000
+
+// Appends everything it is sent to a file, for logs and M500
+// The file is kept open and written in whole sectors, call idle() regularly so a quiet log still reaches the card, and close() or delete when done
 class AppendFileStream : public StreamOutput {
     public:
-        AppendFileStream(const char *filename) { fn= strdup(filename); }
-        virtual ~AppendFileStream(){ free(fn); }
+        AppendFileStream(const char *filename);
+        virtual ~AppendFileStream();
         int puts(const char*);
 
+        bool flush();
+        void idle();
+        void close();
+
     private:
+        bool open();
+        bool write_buffer();
+
         char *fn;
+        mbed::FileHandle *handle;
+        char buffer[APPEND_BUFFER_SIZE];
+        size_t used;                // Bytes waiting in the buffer
+        size_t room;                // Bytes the buffer takes before it reaches the next sector boundary of the file
+        size_t unsynced;            // Bytes written to the file since the last sync
+        uint32_t dirty_since;       // us_ticker time the oldest data not on the card was written
+        bool dirty;
+        bool failed;                // The file could not be opened or written, drop everything
 };
 
 #endif
@@ -32,11 +32,13 @@ static const char *FR_ERRORS[] = {
 
 FATFileHandle::FATFileHandle(FIL_t fh) {
     _fh = fh;
+    _linkmap = NULL;
 }
     
 int FATFileHandle::close() {
     FFSDEBUG("close\n");
     int retval = f_close(&_fh);
+    delete[] _linkmap;
     delete this;
     return retval;
 }
@@ -74,6 +76,10 @@ off_t FATFileHandle::lseek(off_t position, int whence) {
     } else if(whence==SEEK_CUR) {
         position += _fh.fptr;
     }
+    // Read only files get a cluster link map on their first real seek, so this one and the next don't follow the FAT chain
+    if(_linkmap == NULL && !(_fh.flag & FA_WRITE) && position != 0 && (DWORD)position != _fh.fptr) {
+        make_linkmap();
+    }
     FRESULT res = f_lseek(&_fh, position);
     if(res) {
         FFSDEBUG("lseek failed (%d, %s)\n", res, FR_ERRORS[res]);
@@ -94,6 +100,29 @@ int FATFileHandle::fsync() {
     return 0;
 }
 
+// Build the link map, growing it as needed, or stay with normal seeks if the file is too fragmented
+bool FATFileHandle::make_linkmap() {
+    DWORD items = FAT_LINKMAP_ITEMS;
+    while(items <= FAT_LINKMAP_MAX_ITEMS) {
+        _linkmap = new DWORD[items];
+        _linkmap[0] = items;
+        _fh.cltbl = _linkmap;
+        FRESULT res = f_lseek(&_fh, CREATE_LINKMAP);
+        if(res == FR_OK) {
+            return true;
+        }
+        DWORD needed = _linkmap[0];
+        _fh.cltbl = 0;
+        delete[] _linkmap;
+        _linkmap = NULL;
+        if(res != FR_NOT_ENOUGH_CORE) {
+            return false;
+        }
+        items = needed;
+    }
+    return false;
+}
+
 off_t FATFileHandle::flen() {
     FFSDEBUG("flen\n");
     return _fh.fsize;
@@ -7,6 +7,10 @@
 
 #include "FileHandle.h"
 #include "ff.h"
+
+// Cluster link map, see FatFs fast seek : two items per fragment of the file plus two
+#define FAT_LINKMAP_ITEMS       32
+#define FAT_LINKMAP_MAX_ITEMS   256
 
 namespace mbed {
 
@@ -24,7 +28,10 @@ public:
 
 protected:
 
+    bool make_linkmap();
+
     FIL_t _fh;
+    DWORD *_linkmap;
 
 };
 
@@ -131,4 +131,27 @@ int FATFileSystem::mkdir(const char *name, mode_t mode) {
     return res == 0 ? 0 : -1;
 }
 
+// FatFs asks for runs of consecutive sectors, disks that can transfer them in one go override these
+int FATFileSystem::disk_read_sectors(char *buffer, int sector, int count) {
+    for(int i = 0; i < count; i++) {
+        int res = disk_read(buffer, sector + i);
+        if(res) {
+            return res;
+        }
+        buffer += 512;
+    }
+    return 0;
+}
+
+int FATFileSystem::disk_write_sectors(const char *buffer, int sector, int count) {
+    for(int i = 0; i < count; i++) {
+        int res = disk_write(buffer, sector + i);
+        if(res) {
+            return res;
+        }
+        buffer += 512;
+    }
+    return 0;
+}
+
 } // namespace mbed
@@ -24,6 +24,7 @@ using namespace std;
 // All values are read into a cache, that is then used by modules to read their configuration
 Config::Config(){
     this->config_cache_loaded = false;
+    this->reading_module = NULL;
 
     // Config source for firm config found in src/config.default
     this->config_sources.push_back( new FirmConfigSource() );
@@ -42,8 +43,11 @@ Config::Config(){
        fcs = new FileConfigSource("/sd/config",    SD_CONFIGSOURCE_CHECKSUM   );
     else if( file_exists("/sd/config.txt") )
        fcs = new FileConfigSource("/sd/config.txt",    SD_CONFIGSOURCE_CHECKSUM   );
-    if( fcs != NULL )
+    if( fcs != NULL ){
+        // The SD config is the big one, and the card is writable, so it gets a binary cache
+        fcs->binary_cache = true;
         this->config_sources.push_back( fcs );
+    }
 
     // Pre-load the config cache
     this->config_cache_load();
@@ -63,11 +67,14 @@ void Config::set_string( string setting, string value ){
 
     this->config_cache.replace_or_push_back(cv);
 
-    this->kernel->call_event(ON_CONFIG_RELOAD);
+    // Only the modules that use this setting need to reload
+    uint16_t check_sums[3] = { cv->check_sums[0], cv->check_sums[1], cv->check_sums[2] };
+    this->kernel->reload_config(check_sums);
 }
 
 // Get a list of modules, used by module "pools" that look for the "enable" keyboard to find things like "moduletype.modulename.enable" as the marker of a new instance of a module
 void Config::get_module_list(vector<uint16_t>* list, uint16_t family){
+    this->config_cache.sort();
     for( unsigned int i=1; i<this->config_cache.size(); i++){
         ConfigValue* value = this->config_cache.at(i);
         //if( value->check_sums.size() == 3 && value->check_sums.at(2) == CHECKSUM("enable") && value->check_sums.at(0) == family ){
@@ -136,27 +143,13 @@ ConfigValue* Config::value(uint16_t check_sum){
 // Because we don't like to waste space in Flash with lengthy config parameter names, we take a checksum instead so that the name does not have to be stored
 // See get_checksum
 ConfigValue* Config::value(uint16_t check_sums[]){
-    ConfigValue* result = this->config_cache[0];
+    if( this->reading_module != NULL ){ this->reading_module->note_config_read(check_sums); }
+
     bool cache_preloaded = this->config_cache_loaded;
     if( !cache_preloaded ){ this->config_cache_load(); }
 
-    for( unsigned int i=1; i<this->config_cache.size(); i++){
-        // If this line matches the checksum
-        bool match = true;
-        unsigned int counter = 0;
-        while(check_sums[counter] != 0x0000 && counter <= 2 ){
-             if(this->config_cache[i]->check_sums[counter] != check_sums[counter] ){
-                match = false;
-                break;
-            }
-            counter++;
-        }
-        if( match == false ){
-            continue;
-        }
-        result = this->config_cache[i];
-        break;
-    }
+    ConfigValue* result = this->config_cache.lookup(check_sums);
+    if( result == NULL ){ result = this->config_cache[0]; }
 
     if( !cache_preloaded ){
         this->config_cache_clear();
@@ -49,6 +49,7 @@ class Config : public Module {
         ConfigCache config_cache;             // A cache in which ConfigValues are kept
         vector<ConfigSource*> config_sources; // A list of all possible coniguration sources
         bool   config_cache_loaded;           // Whether or not the cache is currently popluated
+        Module* reading_module;               // Module that is loading its config, every setting it reads is noted in its config_keys
 };
 
 #endif
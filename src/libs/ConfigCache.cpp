@@ -0,0 +1,59 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "libs/Kernel.h"
+#include "ConfigCache.h"
+#include <algorithm>
+
+// The three checksums as one number, so values sort by first checksum, then second, then third
+static inline uint64_t config_key(const uint16_t check_sums[3]){
+    return ((uint64_t)check_sums[0] << 32) | ((uint32_t)check_sums[1] << 16) | check_sums[2];
+}
+
+static bool config_value_less(const ConfigValue* a, const ConfigValue* b){
+    return config_key(a->check_sums) < config_key(b->check_sums);
+}
+
+// Sort the values by checksums, and drop the ones a later source replaced
+void ConfigCache::sort(){
+    if( this->sorted ){ return; }
+    this->sorted = true;
+    if( this->size() < 3 ){ return; }
+
+    // Stable, so values for the same setting stay in the order they were pushed in
+    std::stable_sort(this->begin() + 1, this->end(), config_value_less);
+
+    unsigned int kept = 1;
+    for( unsigned int i = 1; i < this->size(); i++ ){
+        if( i + 1 < this->size() && config_key(this->at(i)->check_sums) == config_key(this->at(i + 1)->check_sums) ){
+            delete this->at(i);
+            continue;
+        }
+        this->at(kept++) = this->at(i);
+    }
+    this->resize(kept);
+}
+
+// Find a value by checksums, unused trailing checksums are 0x0000 and match anything, as they always did
+// Returns NULL if there is no such value
+ConfigValue* ConfigCache::lookup(const uint16_t check_sums[3]){
+    if( this->size() < 2 ){ return NULL; }
+    this->sort();
+
+    // 0x0000 sorts first, so the first value at or after the key is the first one that can match it
+    ConfigValue key;
+    key.check_sums[0] = check_sums[0];
+    key.check_sums[1] = check_sums[1];
+    key.check_sums[2] = check_sums[2];
+    std::vector<ConfigValue*>::iterator found = std::lower_bound(this->begin() + 1, this->end(), &key, config_value_less);
+    if( found == this->end() ){ return NULL; }
+
+    for( unsigned int counter = 0; counter < 3 && check_sums[counter] != 0x0000; counter++ ){
+        if( (*found)->check_sums[counter] != check_sums[counter] ){ return NULL; }
+    }
+    return *found;
+}
@@ -13,44 +13,24 @@ using namespace std;
 
 #include "ConfigValue.h"
 
+// All the config values, from all sources. The first element is a special empty ConfigValue for values not found
+// Values are appended as the sources are read, and sorted by checksums the first time one is looked up, so loading is O(n log n) and lookups O(log n)
 class ConfigCache : public std::vector<ConfigValue*> {
     public:
-        ConfigCache(){}
-        
+        ConfigCache(){ this->sorted = true; }
+
         // If we find an existing value, replace it, otherwise, push it at the back of the list
+        // Duplicates are only resolved by sort(), the last value pushed for a setting wins
         void replace_or_push_back(ConfigValue* new_value){
-       
-           bool value_exists = false;
-            // For each already existing element
-            for( unsigned int i=1; i<this->size(); i++){
-                // If this configvalue matches the checksum
-                bool match = true;
-                unsigned int counter = 0;
-                while( counter < 3 && new_value->check_sums[counter] != 0x0000 ){
-                    if(this->at(i)->check_sums[counter] != new_value->check_sums[counter]  ){
-                        match = false;
-                        break;
-                    }
-                    counter++;
-                }
-                if( match == false ){ continue; }
-                value_exists = true;
-                
-                // Replace with the provided value
-                delete this->at(i);
-                this->at(i) = new_value;
-                break;
-            }
-
-            // Value does not already exists, add to the list
-            if( value_exists == false ){
-                this->push_back(new_value);
-            }
-
+            this->push_back(new_value);
+            this->sorted = false;
         }
 
-};
-
+        void sort();
+        ConfigValue* lookup(const uint16_t check_sums[3]);
 
+    private:
+        bool sorted;    // Whether the values after the first are in checksum order, without duplicates
+};
 
 #endif
@@ -0,0 +1,48 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "libs/Kernel.h"
+#include "ConfigSource.h"
+#include "ConfigValue.h"
+#include "ConfigCache.h"
+#include "libs/utils.h"
+#include <string.h>
+
+// Position of the first character of line, from start, that is ( or is not ) one of set
+static size_t find_in(const char* line, size_t length, size_t start, const char* set, bool in_set){
+    while( start < length && ( strchr(set, line[start]) != NULL ) != in_set ){ start++; }
+    return start;
+}
+
+// Split a line ( without its \n ) in key checksums and value, returns false for comments, blank lines and lines without a value
+bool ConfigSource::parse_line(const char* line, size_t length, ConfigLine* result){
+    if( length < 3 || line[0] == '#' ){ return false; }
+
+    size_t begin_key   = find_in(line, length, 0, " \t", false);
+    size_t end_key     = find_in(line, length, begin_key, " \t\r", true);
+    size_t begin_value = find_in(line, length, end_key, " \t", false);
+    if( begin_key == end_key || begin_value >= length || line[begin_value] == '\r' || line[begin_value] == '#' ){ return false; }
+
+    get_checksums(result->check_sums, string(line + begin_key, end_key - begin_key).append(" "));
+
+    size_t end_value = find_in(line, length, begin_value + 1, "\r# \t", true);
+    result->value.assign(line + begin_value, end_value - begin_value);
+    result->value_start = begin_value;
+    result->value_room  = find_in(line, length, begin_value + 1, "\r#", true) - begin_value;
+    return true;
+}
+
+// Append a setting to the cache
+void ConfigSource::add_to_cache(ConfigCache* cache, ConfigLine* line){
+    ConfigValue* result = new ConfigValue;
+    result->found = true;
+    result->check_sums[0] = line->check_sums[0];
+    result->check_sums[1] = line->check_sums[1];
+    result->check_sums[2] = line->check_sums[2];
+    result->value = line->value;
+    cache->replace_or_push_back(result);
+}
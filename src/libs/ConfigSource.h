@@ -16,6 +16,14 @@ using namespace std;
 
 class ConfigValue;
 
+// One setting line of a config file, as found by ConfigSource::parse_line
+struct ConfigLine {
+    uint16_t check_sums[3];
+    string   value;
+    size_t   value_start;   // Where the value starts in the line
+    size_t   value_room;    // How long the value can get before it runs into the end of the line or a comment
+};
+
 class ConfigSource {
     public:
         ConfigSource(){}
@@ -28,65 +36,8 @@ class ConfigSource {
 
         uint16_t name_checksum;
     protected:
-        virtual string process_char_from_ascii_config(int c, ConfigCache* cache) {
-            static string buffer;
-            if (c == '\n' || c == EOF)
-            {
-                // We have a new line
-                if( buffer[0] == '#' ){ buffer.clear(); return ""; } // Ignore comments
-                if( buffer.length() < 3 ){ buffer.clear(); return ""; } //Ignore empty lines
-                size_t begin_key = buffer.find_first_not_of(" ");
-                size_t begin_value = buffer.find_first_not_of(" ", buffer.find_first_of(" ", begin_key));
-
-                uint16_t check_sums[3];
-                get_checksums(check_sums, buffer.substr(begin_key,  buffer.find_first_of(" ", begin_key) - begin_key).append(" "));
-
-                ConfigValue* result = new ConfigValue;
-
-                result->found = true;
-                result->check_sums[0] = check_sums[0];
-                result->check_sums[1] = check_sums[1];
-                result->check_sums[2] = check_sums[2];
-
-                result->value = buffer.substr(begin_value, buffer.find_first_of("\r\n# ", begin_value+1)-begin_value);
-                // Append the newly found value to the cache we were passed
-                cache->replace_or_push_back(result);
-
-                buffer.clear();
-
-                return result->value;
-            }
-            else
-                buffer += c;
-
-            return "";
-        };
-        virtual string process_char_from_ascii_config(int c, uint16_t line_checksums[3]) {
-            static string buffer;
-            string value;
-            if (c == '\n' || c == EOF)
-            {
-                // We have a new line
-                if( buffer[0] == '#' ){ buffer.clear(); return ""; } // Ignore comments
-                if( buffer.length() < 3 ){ buffer.clear(); return ""; } //Ignore empty lines
-                size_t begin_key = buffer.find_first_not_of(" ");
-                size_t begin_value = buffer.find_first_not_of(" ", buffer.find_first_of(" ", begin_key));
-
-                uint16_t check_sums[3];
-                get_checksums(check_sums, buffer.substr(begin_key,  buffer.find_first_of(" ", begin_key) - begin_key).append(" "));
-
-                if(check_sums[0] == line_checksums[0] && check_sums[1] == line_checksums[1] && check_sums[2] == line_checksums[2] ){
-                    value = buffer.substr(begin_value, buffer.find_first_of("\r\n# ", begin_value+1)-begin_value);
-                    buffer.clear();
-                    return value;
-                }
-
-                buffer.clear();
-            }
-            else
-                buffer += c;
-            return value;
-        };
+        bool parse_line(const char* line, size_t length, ConfigLine* result);
+        void add_to_cache(ConfigCache* cache, ConfigLine* line);
 };
 
 
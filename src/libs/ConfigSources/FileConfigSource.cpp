@@ -20,20 +20,155 @@ FileConfigSource::FileConfigSource(string config_file, uint16_t name_checksum){
     this->name_checksum = name_checksum;
     this->config_file = config_file;
     this->config_file_found = false;
+    this->binary_cache = false;
 }
 
 // Transfer all values found in the file to the passed cache
 void FileConfigSource::transfer_values_to_cache( ConfigCache* cache ){
 
     if( this->has_config_file() == false ){return;}
-    // Open the config file ( find it if we haven't already found it )
+
+    // If the file did not change since the binary cache was written, skip parsing it
+    uint32_t hash = 0;
+    if( this->binary_cache ){
+        hash = this->hash_file();
+        if( this->load_binary_cache(cache, hash) ){ return; }
+    }
+
+    unsigned int first = cache->size();
+    this->scan(cache, NULL, NULL, NULL);
+
+    if( this->binary_cache ){
+        this->save_binary_cache(cache, first, hash);
+    }
+}
+
+// Read the file in blocks and parse it line by line : every setting goes to cache if we are given one,
+// and the last line for the wanted checksums goes to found, with the offset of that line in the file. Returns true if that line was found
+bool FileConfigSource::scan(ConfigCache* cache, const uint16_t wanted[3], ConfigLine* found, long* found_offset){
     FILE *lp = fopen(this->get_config_file().c_str(), "r");
-    int c;
-    // For each line
+    if( lp == NULL ){ return false; }
+
+    char block[CONFIG_READ_BLOCK_SIZE];
+    string line;
+    ConfigLine setting;
+    long offset = 0;
+    bool matched = false;
+    size_t n;
     do {
-        process_char_from_ascii_config(c = fgetc(lp), cache);
-    } while (c != EOF);
+        n = fread(block, 1, sizeof(block), lp);
+        size_t start = 0;
+        for( size_t i = 0; i <= n; i++ ){
+            if( i < n && block[i] != '\n' ){ continue; }
+            line.append(block + start, i - start);
+            start = i + 1;
+            // The last line of the block continues in the next one, unless this was the end of the file
+            if( i == n && n > 0 ){ break; }
+
+            if( this->parse_line(line.data(), line.size(), &setting) ){
+                if( cache != NULL ){
+                    this->add_to_cache(cache, &setting);
+                }
+                if( wanted != NULL && setting.check_sums[0] == wanted[0] && setting.check_sums[1] == wanted[1] && setting.check_sums[2] == wanted[2] ){
+                    *found = setting;
+                    if( found_offset != NULL ){ *found_offset = offset; }
+                    matched = true;
+                }
+            }
+            offset += line.size() + 1;
+            line.clear();
+        }
+    } while( n > 0 );
+
+    fclose(lp);
+    return matched;
+}
+
+// FNV-1a over the whole file, raw blocks only, this is much cheaper than parsing it
+uint32_t FileConfigSource::hash_file(){
+    FILE *lp = fopen(this->get_config_file().c_str(), "r");
+    if( lp == NULL ){ return 0; }
+
+    uint8_t block[CONFIG_READ_BLOCK_SIZE];
+    uint32_t hash = 2166136261UL;
+    size_t n;
+    while( (n = fread(block, 1, sizeof(block), lp)) > 0 ){
+        for( size_t i = 0; i < n; i++ ){
+            hash = (hash ^ block[i]) * 16777619UL;
+        }
+    }
+    fclose(lp);
+    return hash;
+}
+
+// config or config.txt is cached in config.bin
+string FileConfigSource::binary_cache_file(){
+    string filename = this->config_file;
+    size_t dot = filename.find_last_of('.');
+    size_t slash = filename.find_last_of('/');
+    if( dot != string::npos && ( slash == string::npos || dot > slash ) ){
+        filename.erase(dot);
+    }
+    return filename + ".bin";
+}
+
+// Add the settings from the binary cache to the cache, if it was built from this version of the file
+bool FileConfigSource::load_binary_cache(ConfigCache* cache, uint32_t hash){
+    FILE *lp = fopen(this->binary_cache_file().c_str(), "r");
+    if( lp == NULL ){ return false; }
+
+    ConfigCacheHeader header;
+    if( fread(&header, sizeof(header), 1, lp) != 1 || header.magic != CONFIG_CACHE_MAGIC || header.version != CONFIG_CACHE_VERSION || header.hash != hash ){
+        fclose(lp);
+        return false;
+    }
+
+    unsigned int first = cache->size();
+    ConfigLine setting;
+    char value[256];
+    for( unsigned int i = 0; i < header.count; i++ ){
+        uint8_t length;
+        if( fread(setting.check_sums, sizeof(setting.check_sums), 1, lp) != 1 || fread(&length, 1, 1, lp) != 1 || fread(value, 1, length, lp) != length ){
+            // Truncated, forget what we got from it and parse the text instead
+            while( cache->size() > first ){
+                delete cache->back();
+                cache->pop_back();
+            }
+            fclose(lp);
+            return false;
+        }
+        setting.value.assign(value, length);
+        this->add_to_cache(cache, &setting);
+    }
     fclose(lp);
+    return true;
+}
+
+// Write the settings this file added to the cache, from first on, to the binary cache
+void FileConfigSource::save_binary_cache(ConfigCache* cache, unsigned int first, uint32_t hash){
+    string filename = this->binary_cache_file();
+    FILE *lp = fopen(filename.c_str(), "w");
+    if( lp == NULL ){ return; }
+
+    ConfigCacheHeader header;
+    header.magic   = CONFIG_CACHE_MAGIC;
+    header.version = CONFIG_CACHE_VERSION;
+    header.count   = cache->size() - first;
+    header.hash    = hash;
+    bool good = ( fwrite(&header, sizeof(header), 1, lp) == 1 );
+
+    for( unsigned int i = first; good && i < cache->size(); i++ ){
+        ConfigValue* value = cache->at(i);
+        uint8_t length = value->value.size();
+        good = value->value.size() < 256
+            && fwrite(value->check_sums, sizeof(value->check_sums), 1, lp) == 1
+            && fwrite(&length, 1, 1, lp) == 1
+            && fwrite(value->value.data(), 1, length, lp) == length;
+    }
+
+    // Better no cache than a bad one
+    if( fclose(lp) != 0 ){ good = false; }
+    if( !good ){ remove(filename.c_str()); }
 }
 
 // Return true if the check_sums match
@@ -43,43 +178,27 @@ bool FileConfigSource::is_named( uint16_t check_sum ){
 
 // Write a config setting to the file
 void FileConfigSource::write( string setting, string value ){
-    // Open the config file ( find it if we haven't already found it )
+    uint16_t check_sums[3];
+    get_checksums(check_sums, setting + " ");
+
+    ConfigLine line;
+    long offset;
+    if( !this->scan(NULL, check_sums, &line, &offset) ){
+        //this->kernel->streams->printf("ERROR: configuration key not found\r\n");
+        return;
+    }
+    if( value.length() >= line.value_room ){
+        //this->kernel->streams->printf("ERROR: Not enough room for value\r\n");
+        return;
+    }
+
+    // Update value
+    for( size_t i = value.length(); i < line.value_room; i++ ){ value += " "; }
     FILE *lp = fopen(this->get_config_file().c_str(), "r+");
-    string buffer;
-    int c;
-    // For each line
-    do {
-        c = fgetc (lp);
-        if (c == '\n' || c == EOF){
-            // We have a new line
-            if( buffer[0] == '#' ){ buffer.clear(); continue; } // Ignore comments
-            if( buffer.length() < 3 ){ buffer.clear(); continue; } //Ignore empty lines
-            size_t begin_key = buffer.find_first_not_of(" \t");
-            size_t begin_value = buffer.find_first_not_of(" \t", buffer.find_first_of(" \t", begin_key));
-            // If this line matches the checksum
-            string candidate = buffer.substr(begin_key,  buffer.find_first_of(" \t", begin_key) - begin_key);
-            if( candidate.compare(setting) != 0 ){ buffer.clear(); continue; }
-            int free_space = int(int(buffer.find_first_of("\r\n#", begin_value+1))-begin_value);
-            if( int(value.length()) >= free_space ){
-                //this->kernel->streams->printf("ERROR: Not enough room for value\r\n");
-                fclose(lp);
-                return;
-            }
-            // Update value
-            for( int i = value.length(); i < free_space; i++){ value += " "; }
-            fpos_t pos;
-            fgetpos( lp, &pos );
-            int start = pos - buffer.length() + begin_value - 1;
-            fseek(lp, start, SEEK_SET);
-            fputs(value.c_str(), lp);
-            fclose(lp);
-            return;
-        }else{
-            buffer += c;
-        }
-    } while (c != EOF);
+    if( lp == NULL ){ return; }
+    fseek(lp, offset + line.value_start, SEEK_SET);
+    fputs(value.c_str(), lp);
     fclose(lp);
-    //this->kernel->streams->printf("ERROR: configuration key not found\r\n");
 }
 
 // Return the value for a specific checksum
@@ -88,15 +207,11 @@ string FileConfigSource::read( uint16_t check_sums[3] ){
     string value = "";
 
     if( this->has_config_file() == false ){return value;}
-    // Open the config file ( find it if we haven't already found it )
-    FILE *lp = fopen(this->get_config_file().c_str(), "r");
-    int c;
-    // For each line
-    do {
-        c = fgetc (lp);
-        process_char_from_ascii_config(c, check_sums);
-    } while (c != EOF);
-    fclose(lp);
+
+    ConfigLine line;
+    if( this->scan(NULL, check_sums, &line, NULL) ){
+        value = line.value;
+    }
 
     return value;
 }
@@ -17,6 +17,20 @@ using namespace std;
 
 #define FILE_CONFIGSOURCE_CHECKSUM    5281      // "file"
 
+#define CONFIG_READ_BLOCK_SIZE        512
+
+// The binary cache is the config's settings already split and checksummed, next to the config file ( config.bin for config or config.txt )
+// It is only used while the hash of the config file's text is the one it was built from
+#define CONFIG_CACHE_MAGIC            0x43464353  // "SCFC"
+#define CONFIG_CACHE_VERSION          1
+
+struct ConfigCacheHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;         // Number of settings
+    uint32_t hash;          // FNV-1a of the config file
+} __attribute__ ((packed));
+
 class FileConfigSource : public ConfigSource {
     public:
         FileConfigSource(string config_file = "/sd/config", uint16_t name_checksum = FILE_CONFIGSOURCE_CHECKSUM);
@@ -30,6 +44,14 @@ class FileConfigSource : public ConfigSource {
 
         string config_file;         // Path to the config file
         bool   config_file_found;   // Wether or not the config file's location is known
+        bool   binary_cache;        // Wether to keep a binary cache of the settings, see ConfigCacheHeader
+
+    private:
+        bool scan(ConfigCache* cache, const uint16_t wanted[3], ConfigLine* found, long* found_offset);
+        uint32_t hash_file();
+        string binary_cache_file();
+        bool load_binary_cache(ConfigCache* cache, uint32_t hash);
+        void save_binary_cache(ConfigCache* cache, unsigned int first, uint32_t hash);
 
 
 };
@@ -27,11 +27,17 @@ FirmConfigSource::FirmConfigSource(uint16_t name_checksum){
 
 // Transfer all values found in the file to the passed cache
 void FirmConfigSource::transfer_values_to_cache( ConfigCache* cache ){
-
-    char* p = &_binary_config_default_start;
+    ConfigLine setting;
+    const char* p = &_binary_config_default_start;
+    const char* end = &_binary_config_default_end;
     // For each line
-    while( p != &_binary_config_default_end ){
-        process_char_from_ascii_config(*p++, cache);
+    while( p < end ){
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if( eol == NULL ){ eol = end; }
+        if( this->parse_line(p, eol - p, &setting) ){
+            this->add_to_cache(cache, &setting);
+        }
+        p = eol + 1;
     }
 }
 
@@ -50,14 +56,18 @@ string FirmConfigSource::read( uint16_t check_sums[3] ){
 
     string value = "";
 
-    char* p = &_binary_config_default_start;
-    // For each line
-    while( p != &_binary_config_default_end ){
-        value = process_char_from_ascii_config(*p++, check_sums);
-        if (value.length())
-            return value;
+    ConfigLine setting;
+    const char* p = &_binary_config_default_start;
+    const char* end = &_binary_config_default_end;
+    // For each line, the last one for this setting wins, as in the cache
+    while( p < end ){
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if( eol == NULL ){ eol = end; }
+        if( this->parse_line(p, eol - p, &setting) && setting.check_sums[0] == check_sums[0] && setting.check_sums[1] == check_sums[1] && setting.check_sums[2] == check_sums[2] ){
+            value = setting.value;
+        }
+        p = eol + 1;
     }
 
     return value;
 }
-
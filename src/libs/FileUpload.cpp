@@ -0,0 +1,95 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FileUpload.h"
+#include "FrameDecoder.h"
+#include "ahbmalloc.h"
+#include "FilePath.h"
+#include <stdlib.h>
+#include <string.h>
+
+FileUpload::FileUpload(){
+    this->handle = NULL;
+    this->buffer = NULL;
+    this->used = 0;
+    this->error = false;
+    this->received = 0;
+    this->expected_length = 0;
+    this->expected_crc = 0;
+    this->crc = 0xFFFF;
+}
+
+// Create the file, we go through the filesystem's FileHandle rather than stdio so we can sync it
+bool FileUpload::open(string filename, uint32_t length, uint16_t crc){
+    if( this->handle != NULL ){ this->close(); }
+
+    if( this->buffer == NULL ){
+        this->buffer = (char*)ahbmalloc(UPLOAD_BUFFER_SIZE, AHB_BANK_1);
+        if( this->buffer == NULL ){ this->buffer = (char*)malloc(UPLOAD_BUFFER_SIZE); }
+        if( this->buffer == NULL ){ return false; }
+    }
+
+    mbed::FilePath path(filename.c_str());
+    if( !path.isFileSystem() ){ return false; }
+    this->handle = path.fileSystem()->open(path.fileName(), O_WRONLY | O_CREAT | O_TRUNC);
+    if( this->handle == NULL ){ return false; }
+
+    this->used = 0;
+    this->error = false;
+    this->received = 0;
+    this->expected_length = length;
+    this->expected_crc = crc;
+    this->crc = 0xFFFF;
+    return true;
+}
+
+// Add data to the file, returns false once anything failed
+bool FileUpload::write(const char* data, size_t length){
+    if( this->handle == NULL || this->error ){ return false; }
+
+    // Binary uploads never go past their announced length
+    if( this->binary() && this->received + length > this->expected_length ){
+        length = this->expected_length - this->received;
+    }
+    this->crc = FrameDecoder::crc16((const uint8_t*)data, length, this->crc);
+    this->received += length;
+
+    while( length > 0 ){
+        size_t room = UPLOAD_BUFFER_SIZE - this->used;
+        size_t chunk = length < room ? length : room;
+        memcpy(this->buffer + this->used, data, chunk);
+        this->used += chunk;
+        data += chunk;
+        length -= chunk;
+        if( this->used == UPLOAD_BUFFER_SIZE && !this->flush() ){ return false; }
+    }
+    return true;
+}
+
+// Write the buffer out and make FatFs commit it and the directory entry, so a reset loses at most one buffer
+bool FileUpload::flush(){
+    if( this->used > 0 ){
+        if( this->handle->write(this->buffer, this->used) != (ssize_t)this->used ){ this->error = true; }
+        this->used = 0;
+    }
+    if( !this->error && this->handle->fsync() != 0 ){ this->error = true; }
+    return !this->error;
+}
+
+// Finish the file, returns false if it is not what was sent
+bool FileUpload::close(){
+    if( this->handle == NULL ){ return false; }
+    bool good = this->flush();
+    this->handle->close();
+    this->handle = NULL;
+
+    if( this->binary() ){
+        good = good && this->received == this->expected_length && this->crc == this->expected_crc;
+        this->expected_length = 0;
+    }
+    return good;
+}
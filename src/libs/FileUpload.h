@@ -0,0 +1,50 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FILEUPLOAD_H
+#define FILEUPLOAD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+using std::string;
+
+namespace mbed { class FileHandle; }
+
+// 8 sectors : a full buffer is written by FatFs straight to the card, as one multiple block write
+#define UPLOAD_BUFFER_SIZE 4096
+
+// Writes a file received over a console stream ( M28 ), buffered in AHB ram and synced to the card every time the buffer is written out
+// Binary uploads know their length and CRC16 up front ( M28 B<bytes> C<crc> ), their data comes in frames, see FrameDecoder
+class FileUpload {
+    public:
+        FileUpload();
+        bool open(string filename, uint32_t length = 0, uint16_t crc = 0);
+        bool write(const char* data, size_t length);
+        bool close();
+
+        bool is_open(){ return this->handle != NULL; }
+        bool binary(){ return this->expected_length > 0; }
+        bool complete(){ return this->binary() && this->received >= this->expected_length; }
+        bool failed(){ return this->error; }
+        uint32_t remaining(){ return this->binary() && this->received < this->expected_length ? this->expected_length - this->received : 0; }
+
+        uint32_t received;          // Bytes received so far
+
+    private:
+        bool flush();
+
+        mbed::FileHandle* handle;
+        char*    buffer;
+        size_t   used;              // Bytes waiting in the buffer
+        bool     error;             // A write failed, the file is no good
+        uint32_t expected_length;   // Binary uploads only
+        uint16_t expected_crc;
+        uint16_t crc;
+};
+
+#endif
@@ -0,0 +1,177 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FrameDecoder.h"
+#include "libs/StreamOutput.h"
+#include "libs/FileUpload.h"
+
+#define STATE_START     0
+#define STATE_SEQUENCE  1
+#define STATE_LENGTH    2
+#define STATE_PAYLOAD   3
+#define STATE_CRC_HIGH  4
+#define STATE_CRC_LOW   5
+
+// Turns the bytes received by a console stream into gcode frames, see FrameDecoder.h for the format
+// The stream feeds it every byte it receives while in framed mode, and executes the payload once a frame is complete
+FrameDecoder::FrameDecoder(){
+    this->enabled  = false;
+    this->upload   = NULL;
+    this->upload_dropping = 0;
+    this->rx_limit = FRAME_MAX_BYTES;
+    this->stop();
+}
+
+// Switch to framed mode, the next frame must have sequence number 0
+void FrameDecoder::start(int window){
+    this->set_window(window);
+    this->expected = 0;
+    this->unacked  = 0;
+    this->unacked_bytes = 0;
+    this->resync   = false;
+    this->state    = STATE_START;
+    this->enabled  = true;
+}
+
+// How many frames the host may have in flight, within what we can acknowledge
+void FrameDecoder::set_window(int window){
+    if( window < 1 ){ window = 1; }
+    if( window > FRAME_MAX_WINDOW ){ window = FRAME_MAX_WINDOW; }
+    this->window = window;
+}
+
+// Back to plain text lines
+void FrameDecoder::stop(){
+    this->enabled  = false;
+    this->window   = 1;
+    this->expected = 0;
+    this->unacked  = 0;
+    this->unacked_bytes = 0;
+    this->resync   = false;
+    this->state    = STATE_START;
+    this->payload.clear();
+    this->upload_dropping = 0;
+
+    // An unfinished binary upload is of no use
+    if( this->upload != NULL ){
+        this->upload->close();
+        this->upload = NULL;
+    }
+}
+
+// Eat one byte, returns FRAME_READY when a good frame is complete and its text is in payload, FRAME_ERROR when a frame has to be sent again
+int FrameDecoder::feed(uint8_t c){
+    switch( this->state ){
+        case STATE_START:
+            // Anything between frames is line noise
+            if( c == FRAME_START ){ this->state = STATE_SEQUENCE; }
+            return FRAME_NONE;
+
+        case STATE_SEQUENCE:
+            this->header[0] = c;
+            this->state = STATE_LENGTH;
+            return FRAME_NONE;
+
+        case STATE_LENGTH:
+            this->header[1] = c;
+            this->received = 0;
+            this->state = ( c == 0 ) ? STATE_CRC_HIGH : STATE_PAYLOAD;
+            return FRAME_NONE;
+
+        case STATE_PAYLOAD:
+            this->buffer[this->received++] = c;
+            if( this->received == this->header[1] ){ this->state = STATE_CRC_HIGH; }
+            return FRAME_NONE;
+
+        case STATE_CRC_HIGH:
+            this->crc = c << 8;
+            this->state = STATE_CRC_LOW;
+            return FRAME_NONE;
+
+        case STATE_CRC_LOW:
+            this->crc |= c;
+            this->state = STATE_START;
+            break;
+    }
+
+    // Frame is complete, check it
+    uint16_t crc = crc16(this->header, 2);
+    crc = crc16(this->buffer, this->received, crc);
+    bool good = ( crc == this->crc );
+
+    // Frames still in flight after a bad one are dropped quietly, the host resends them all once it gets the rs
+    if( this->resync ){
+        if( !good || this->header[0] != this->expected ){ return FRAME_NONE; }
+        this->resync = false;
+    }
+
+    if( !good || this->header[0] != this->expected ){
+        this->resync = true;
+        return FRAME_ERROR;
+    }
+
+    this->expected++;
+    this->payload.assign((const char*)this->buffer, this->received);
+    return FRAME_READY;
+}
+
+// If a binary upload is running, the payload is file data : write it and return true, the stream must not execute it
+// Data of an upload that already failed is not executed either
+bool FrameDecoder::take_upload(){
+    if( this->upload == NULL ){
+        if( this->upload_dropping == 0 ){ return false; }
+        this->upload_dropping -= this->payload.size() < this->upload_dropping ? this->payload.size() : this->upload_dropping;
+        return true;
+    }
+    if( !this->upload->write(this->payload.data(), this->payload.size()) ){
+        this->upload_dropping = this->upload->remaining();
+    }
+    return true;
+}
+
+// The payload was executed : acknowledge it, batched unless the host is about to run out of window ( frames or bytes ) or we have nothing else to do
+void FrameDecoder::processed(StreamOutput* stream, bool more_pending){
+    // The last frame of a binary upload, or the first one that could not be written : say how it went, and acknowledge right away so the host gets it in order
+    if( this->upload != NULL && ( this->upload->complete() || this->upload->failed() ) ){
+        if( this->upload->close() ){
+            stream->printf("Done saving file.\r\n");
+        }else{
+            stream->printf("Error: upload failed, CRC mismatch or write error\r\n");
+        }
+        this->upload = NULL;
+        more_pending = false;
+    }
+
+    this->unacked++;
+    this->unacked_bytes += this->header[1] + FRAME_OVERHEAD;
+    if( !this->enabled || !more_pending || this->unacked >= ( this->window + 1 ) / 2 || this->unacked_bytes >= this->rx_limit / 2 ){
+        stream->printf("ok S%u\r\n", (uint8_t)(this->expected - 1));
+        this->unacked = 0;
+        this->unacked_bytes = 0;
+    }
+}
+
+// Ask the host to go back to the first frame we did not accept
+void FrameDecoder::reject(StreamOutput* stream){
+    if( this->unacked > 0 ){
+        stream->printf("ok S%u\r\n", (uint8_t)(this->expected - 1));
+        this->unacked = 0;
+        this->unacked_bytes = 0;
+    }
+    stream->printf("rs S%u\r\n", this->expected);
+}
+
+// CRC16-CCITT ( polynomial 0x1021 ), without a table to save flash : frames are short
+uint16_t FrameDecoder::crc16(const uint8_t* data, size_t length, uint16_t crc){
+    while( length-- ){
+        crc ^= (uint16_t)(*data++) << 8;
+        for( int i = 0; i < 8; i++ ){
+            crc = ( crc & 0x8000 ) ? ( crc << 1 ) ^ 0x1021 : ( crc << 1 );
+        }
+    }
+    return crc;
+}
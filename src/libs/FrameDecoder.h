@@ -0,0 +1,67 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRAMEDECODER_H
+#define FRAMEDECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+using std::string;
+
+class StreamOutput;
+class FileUpload;
+
+// Framed mode for a console stream, switched on and off with M960
+// Each command comes as : STX, sequence number, payload length, payload ( the gcode text ), CRC16 ( CCITT, big endian ) over sequence, length and payload
+// The host can have up to *window* frames, and up to *rx_limit* bytes of frames, in flight, they are acknowledged in batches with "ok S<last sequence>", a bad frame gets "rs S<expected sequence>"
+// The byte limit is what the stream's receive buffer holds, so frames that come in while a command runs are never lost
+// During a binary upload ( M28 B<bytes> C<crc> ), payloads are file data rather than gcode, until the announced length is received
+// If writing the file fails, the upload ends there, and the rest of its data is dropped as it comes
+
+#define FRAME_START         0x02
+#define FRAME_MAX_WINDOW    32
+#define FRAME_OVERHEAD      5       // start, sequence, length and CRC bytes around the payload
+#define FRAME_MAX_BYTES     ( 255 + FRAME_OVERHEAD )
+
+#define FRAME_NONE          0
+#define FRAME_READY         1
+#define FRAME_ERROR         2
+
+class FrameDecoder {
+    public:
+        FrameDecoder();
+        void start(int window);
+        void set_window(int window);
+        void stop();
+        int  feed(uint8_t c);
+        void processed(StreamOutput* stream, bool more_pending);
+        void reject(StreamOutput* stream);
+        bool take_upload();
+
+        static uint16_t crc16(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF);
+
+        bool     enabled;         // Whether the stream is in framed mode
+        uint8_t  window;          // How many frames the host may send before waiting for an ack
+        uint8_t  expected;        // Sequence number of the next frame we accept
+        uint8_t  unacked;         // Frames executed since the last ack
+        uint16_t unacked_bytes;   // Bytes of those frames
+        uint16_t rx_limit;        // How many bytes of frames the host may have in flight, set by the stream to what it can buffer
+        bool     resync;          // A frame was rejected, drop everything until the host resends the expected one
+        string   payload;         // Gcode text of the last complete frame
+        FileUpload* upload;       // Binary upload the payloads go to, if any
+        uint32_t upload_dropping; // Bytes of a failed upload still to come, they are dropped
+
+    private:
+        uint8_t  state;
+        uint8_t  header[2];       // sequence and length of the frame being received
+        uint8_t  buffer[255];
+        uint8_t  received;
+        uint16_t crc;
+};
+
+#endif
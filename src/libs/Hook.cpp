@@ -5,4 +5,8 @@ extern "C"{
 
 // Hook is just a glorified FPointer
 
-Hook::Hook(){}
+Hook::Hook(){
+    this->interval = 0;
+    this->deadline = 0;
+    this->next = NULL;
+}
@@ -2,13 +2,14 @@
 #define HOOK_H
 #include "libs/FPointer.h"
 
-// Hook is just a glorified FPointer
+// Hook is just a glorified FPointer, with what SlowTicker needs to schedule it
 
 class Hook : public FPointer {
     public:
         Hook();
-        int     interval;
-        int     countdown;
+        uint32_t interval;      // Timer ticks between calls
+        uint32_t deadline;      // Timer count of the next call
+        Hook*    next;          // Next hook to be due, see SlowTicker
 };
 
 #endif
@@ -14,6 +14,8 @@
 #include "libs/Pauser.h"
 #include "libs/StreamOutputPool.h"
 #include <mri.h>
+#include "us_ticker_api.h"
+#include "libs/Profiler.h"
 
 #include "modules/communication/SerialConsole.h"
 #include "modules/communication/GcodeDispatch.h"
@@ -22,7 +24,12 @@
 #include "modules/robot/Stepper.h"
 #include "modules/robot/Conveyor.h"
 #include "modules/tools/endstops/Endstops.h"
+#include "modules/communication/utils/Gcode.h"
+#include "libs/SerialMessage.h"
+#include "libs/utils.h"
+#include <string.h>
 #include <malloc.h>
+#include <algorithm>
 
 
 
@@ -31,6 +38,17 @@
 
 Kernel* Kernel::instance;
 
+// Time spent in each event, all modules together. For ON_MAIN_LOOP and ON_IDLE, the "tasks" command breaks it down by module
+static ProfileZone event_zones[NUMBER_OF_DEFINED_EVENTS];
+static const char* const event_names[NUMBER_OF_DEFINED_EVENTS] = {
+    #define EVENT(name, func) #name,
+    #include "libs/Event.h"
+    #undef EVENT
+};
+
+// How often idle_wait calls ON_IDLE at most, unless asked to
+#define IDLE_WAIT_PERIOD_US 1000
+
 // This is used to configure UARTs depending on the MRI configuration, see Kernel::Kernel()
 static int isDebugMonitorUsingUart0(){
     return NVIC_GetPriority(UART0_IRQn) == 0;
@@ -39,6 +57,14 @@ static int isDebugMonitorUsingUart0(){
 // The kernel is the central point in Smoothie : it stores modules, and handles event calls
 Kernel::Kernel(){
     instance= this; // setup the Singleton instance of the kernel
+    this->idle_requested = false;
+    this->last_idle = 0;
+    this->scheduler = new TaskScheduler();
+
+    ProfileZone::start_counter();
+    for( int i = 0; i < NUMBER_OF_DEFINED_EVENTS; i++ ){
+        event_zones[i].name = event_names[i];
+    }
     
     // Config first, because we need the baud_rate setting before we start serial
     this->config         = new Config();
@@ -73,6 +99,7 @@ Kernel::Kernel(){
     // Set other priorities lower than the timers
     NVIC_SetPriority(ADC_IRQn, 4);
     NVIC_SetPriority(USB_IRQn, 4);
+    NVIC_SetPriority(DMA_IRQn, 4);
 
     // If MRI is enabled
     if( MRI_ENABLE ){
@@ -108,25 +135,222 @@ Kernel::Kernel(){
 }
 
 // Add a module to Kernel. We don't actually hold a list of modules, we just tell it where Kernel is
+// Settings the module reads while it loads are noted, see reload_config
 void Kernel::add_module(Module* module){
     module->kernel = this;
+    Module* previous = this->config->reading_module;
+    this->config->reading_module = module;
     module->on_module_loaded();
+    this->config->reading_module = previous;
 }
 
 // Adds a hook for a given module and event
+// ON_MAIN_LOOP and ON_IDLE hooks are tasks of the scheduler instead, see TaskScheduler.h
 void Kernel::register_for_event(_EVENT_ENUM id_event, Module* module){
+    if( TaskScheduler::schedules(id_event) ){
+        this->scheduler->add(id_event, module);
+        return;
+    }
+    if( id_event == ON_GCODE_RECEIVED ){
+        this->gcode_listener(module);
+        return;
+    }
     this->hooks[id_event].push_back(module);
 }
 
+static bool route_before(const GcodeRoute& a, const GcodeRoute& b){
+    return a.code < b.code || ( a.code == b.code && a.listener < b.listener );
+}
+
+static bool route_code_before(const GcodeRoute& a, const GcodeRoute& b){
+    return a.code < b.code;
+}
+
+// The module's place among ON_GCODE_RECEIVED listeners, adding it as a wildcard listener if it is not one yet
+uint16_t Kernel::gcode_listener(Module* module){
+    std::vector<Module*>& listeners = this->hooks[ON_GCODE_RECEIVED];
+    for( unsigned int i = 0; i < listeners.size(); i++ ){
+        if( listeners[i] == module ){ return i; }
+    }
+    listeners.push_back(module);
+    this->gcode_wildcards.push_back(listeners.size() - 1);
+    return listeners.size() - 1;
+}
+
+// The module only wants gcodes with this G or M number, instead of all of them
+// It can take several codes, and still gets them in the order it registered for ON_GCODE_RECEIVED in
+void Kernel::register_for_gcode(Module* module, char letter, unsigned int code){
+    uint16_t listener = this->gcode_listener(module);
+    std::vector<uint16_t>::iterator wildcard = std::find(this->gcode_wildcards.begin(), this->gcode_wildcards.end(), listener);
+    if( wildcard != this->gcode_wildcards.end() ){ this->gcode_wildcards.erase(wildcard); }
+
+    GcodeRoute route;
+    route.code     = ( code & ~GCODE_ROUTE_M ) | ( letter == 'M' ? GCODE_ROUTE_M : 0 );
+    route.listener = listener;
+    std::vector<GcodeRoute>::iterator place = std::lower_bound(this->gcode_routes.begin(), this->gcode_routes.end(), route, route_before);
+    if( place != this->gcode_routes.end() && place->code == route.code && place->listener == listener ){ return; }
+    this->gcode_routes.insert(place, route);
+}
+
+// Forget the codes the module takes, for example before it registers them again on config reload. It does not become a wildcard listener
+void Kernel::clear_gcode_routes(Module* module){
+    uint16_t listener = this->gcode_listener(module);
+    std::vector<uint16_t>::iterator wildcard = std::find(this->gcode_wildcards.begin(), this->gcode_wildcards.end(), listener);
+    if( wildcard != this->gcode_wildcards.end() ){ this->gcode_wildcards.erase(wildcard); }
+
+    for( unsigned int i = 0; i < this->gcode_routes.size(); ){
+        if( this->gcode_routes[i].listener == listener ){
+            this->gcode_routes.erase(this->gcode_routes.begin() + i);
+        }else{
+            i++;
+        }
+    }
+}
+
+// Call ON_GCODE_RECEIVED for the modules that take this gcode's G or M number, and the wildcard listeners
+// The lists are each sorted by listener, we merge them so modules get the gcode in the same order as they would with a plain event call
+// Handlers may register codes while we run ( config reload ), so the lists are walked by index and checked each time, never kept as iterators
+void Kernel::dispatch_gcode(void* argument){
+    Gcode* gcode = static_cast<Gcode*>(argument);
+    unsigned int g = 0, g_end = 0, m = 0, m_end = 0, w = 0;
+    GcodeRoute key;
+    key.listener = 0;
+    if( gcode->has_g ){
+        key.code = gcode->g & ~GCODE_ROUTE_M;
+        std::pair<std::vector<GcodeRoute>::iterator, std::vector<GcodeRoute>::iterator> range = std::equal_range(this->gcode_routes.begin(), this->gcode_routes.end(), key, route_code_before);
+        g     = range.first  - this->gcode_routes.begin();
+        g_end = range.second - this->gcode_routes.begin();
+    }
+    if( gcode->has_m ){
+        key.code = ( gcode->m & ~GCODE_ROUTE_M ) | GCODE_ROUTE_M;
+        std::pair<std::vector<GcodeRoute>::iterator, std::vector<GcodeRoute>::iterator> range = std::equal_range(this->gcode_routes.begin(), this->gcode_routes.end(), key, route_code_before);
+        m     = range.first  - this->gcode_routes.begin();
+        m_end = range.second - this->gcode_routes.begin();
+    }
+
+    while( true ){
+        if( g_end > this->gcode_routes.size() ){ g_end = this->gcode_routes.size(); }
+        if( m_end > this->gcode_routes.size() ){ m_end = this->gcode_routes.size(); }
+
+        unsigned int next = this->hooks[ON_GCODE_RECEIVED].size();
+        if( w < this->gcode_wildcards.size() && this->gcode_wildcards[w] < next ){ next = this->gcode_wildcards[w]; }
+        if( g < g_end && this->gcode_routes[g].listener < next ){ next = this->gcode_routes[g].listener; }
+        if( m < m_end && this->gcode_routes[m].listener < next ){ next = this->gcode_routes[m].listener; }
+        if( next >= this->hooks[ON_GCODE_RECEIVED].size() ){ break; }
+
+        while( w < this->gcode_wildcards.size() && this->gcode_wildcards[w] <= next ){ w++; }
+        while( g < g_end && this->gcode_routes[g].listener <= next ){ g++; }
+        while( m < m_end && this->gcode_routes[m].listener <= next ){ m++; }
+
+        Module* current = this->hooks[ON_GCODE_RECEIVED][next];
+        (current->*kernel_callback_functions[ON_GCODE_RECEIVED])(argument);
+    }
+}
+
+// Give the module's ON_MAIN_LOOP or ON_IDLE task a name, priority, minimum period and time budget ( both in microseconds, 0 for none )
+void Kernel::set_task(_EVENT_ENUM id_event, Module* module, const char* name, uint8_t priority, uint32_t period_us, uint32_t budget_us){
+    this->scheduler->configure(id_event, module, name, priority, period_us, budget_us);
+}
+
+static bool route_command_before(const ConsoleRoute& a, const ConsoleRoute& b){
+    return a.command < b.command;
+}
+
+// The module gets the console lines that start with this command word ( its checksum ), instead of all lines
+// Several modules can take the same command ( cd ), they get it in the order they registered for it
+void Kernel::register_for_command(Module* module, uint16_t command){
+    ConsoleRoute route;
+    route.command = command;
+    route.module  = module;
+    this->console_routes.insert(std::upper_bound(this->console_routes.begin(), this->console_routes.end(), route, route_command_before), route);
+}
+
+// Look at a console line once and hand it to whoever takes it : gcodes, comments and blank lines go to GcodeDispatch,
+// anything else is a shell command, looked up by the checksum of its first word. Modules that registered for ON_CONSOLE_LINE_RECEIVED itself get every line
+void Kernel::route_console_line(void* argument){
+    SerialMessage* message = static_cast<SerialMessage*>(argument);
+    const char* line = message->message.c_str();
+    char first_char = line[0];
+    message->command = 0;
+
+    if( first_char == 'G' || first_char == 'M' || first_char == 'T' || first_char == 'N' || first_char == ';' || first_char == '(' || first_char == ' ' || first_char == '\r' || first_char == '\n' ){
+        this->gcode_dispatch->on_console_line_received(argument);
+    }else if( first_char != '\0' ){
+        message->command = get_checksum(line, strcspn(line, " \r\n"));
+        ConsoleRoute key;
+        key.command = message->command;
+        key.module  = NULL;
+        std::vector<ConsoleRoute>::iterator first = std::lower_bound(this->console_routes.begin(), this->console_routes.end(), key, route_command_before);
+        for( unsigned int i = first - this->console_routes.begin(); i < this->console_routes.size() && this->console_routes[i].command == key.command; i++ ){
+            this->console_routes[i].module->on_console_line_received(argument);
+        }
+    }
+
+    for (Module* current : hooks[ON_CONSOLE_LINE_RECEIVED]) {
+        current->on_console_line_received(argument);
+    }
+}
+
 // Call a specific event without arguments
 void Kernel::call_event(_EVENT_ENUM id_event){
+    ProfileScope profile(event_zones[id_event]);
+    if( TaskScheduler::schedules(id_event) ){
+        this->scheduler->run(id_event, this);
+        return;
+    }
     for (Module* current : hooks[id_event]) {
         (current->*kernel_callback_functions[id_event])(this);
     }
 }
 
+// Call ON_CONFIG_RELOAD for the modules that read the setting with these checksums, or for all modules if there are none
+// Each module notes again which settings it reads, as it reloads
+void Kernel::reload_config(const uint16_t* check_sums){
+    for (Module* current : hooks[ON_CONFIG_RELOAD]) {
+        if( check_sums != NULL && !current->reads_config(check_sums) ){ continue; }
+        Module* previous = this->config->reading_module;
+        this->config->reading_module = current;
+        current->config_keys.clear();
+        current->on_config_reload(this);
+        this->config->reading_module = previous;
+    }
+}
+
+// One turn of a loop that waits for something to happen, instead of calling ON_IDLE as fast as possible
+// ON_IDLE is called when an interrupt asked for it with request_idle(), or once a millisecond, and we sleep until the next interrupt otherwise.
+// Whatever is waited for is a consequence of an interrupt ( steps, blocks ending, endstops polled between steps ), so the caller checks again when we return
+void Kernel::idle_wait(){
+    uint32_t now = us_ticker_read();
+    if( this->idle_requested || now - this->last_idle >= IDLE_WAIT_PERIOD_US ){
+        this->idle_requested = false;
+        this->last_idle = now;
+        this->call_event(ON_IDLE);
+        return;
+    }
+
+    // Interrupts stay off between the check and the sleep so a request can't slip in between, WFI still wakes up on a pending interrupt
+    __disable_irq();
+    if( !this->idle_requested ){
+        __WFI();
+    }
+    __enable_irq();
+}
+
 // Call a specific event with an argument
 void Kernel::call_event(_EVENT_ENUM id_event, void * argument){
+    ProfileScope profile(event_zones[id_event]);
+    if( TaskScheduler::schedules(id_event) ){
+        this->scheduler->run(id_event, argument);
+        return;
+    }
+    if( id_event == ON_GCODE_RECEIVED ){
+        this->dispatch_gcode(argument);
+        return;
+    }
+    if( id_event == ON_CONSOLE_LINE_RECEIVED ){
+        this->route_console_line(argument);
+        return;
+    }
     for (Module* current : hooks[id_event]) {
         (current->*kernel_callback_functions[id_event])(argument);
     }
@@ -15,6 +15,7 @@
 #include "libs/Adc.h"
 #include "libs/Pauser.h"
 #include "libs/PublicData.h"
+#include "libs/TaskScheduler.h"
 #include "modules/communication/SerialConsole.h"
 #include "modules/communication/GcodeDispatch.h"
 #include "modules/tools/toolsmanager/ToolsManager.h"
@@ -25,6 +26,19 @@
 
 #define THEKERNEL Kernel::instance
 
+// A module that takes this G or M code, see Kernel::register_for_gcode
+struct GcodeRoute {
+    uint16_t code;          // The number, with GCODE_ROUTE_M set for M codes
+    uint16_t listener;      // The module's place among ON_GCODE_RECEIVED listeners
+};
+#define GCODE_ROUTE_M 0x8000
+
+// A module that takes this console command, see Kernel::register_for_command
+struct ConsoleRoute {
+    uint16_t command;       // Checksum of the command word
+    Module*  module;
+};
+
 //Module manager
 class Config;
 class Module;
@@ -38,8 +52,15 @@ class Kernel {
 
         void add_module(Module* module);
         void register_for_event(_EVENT_ENUM id_event, Module* module);
+        void register_for_gcode(Module* module, char letter, unsigned int code);
+        void clear_gcode_routes(Module* module);
+        void register_for_command(Module* module, uint16_t command);
         void call_event(_EVENT_ENUM id_event);
         void call_event(_EVENT_ENUM id_event, void * argument);
+        void set_task(_EVENT_ENUM id_event, Module* module, const char* name, uint8_t priority, uint32_t period_us = 0, uint32_t budget_us = 0);
+        void reload_config(const uint16_t* check_sums = NULL);
+        void idle_wait();
+        void request_idle(){ this->idle_requested = true; }
 
         // These modules are aviable to all other modules
         SerialConsole*    serial;
@@ -59,10 +80,21 @@ class Kernel {
         StepTicker*       step_ticker;
         Adc*              adc;
         PublicData*       public_data;
+        TaskScheduler*    scheduler;
         bool              use_leds;
 
     private:
+        volatile bool idle_requested; // Set from interrupts that leave work for an ON_IDLE handler, see idle_wait
+        uint32_t      last_idle;      // us_ticker time ON_IDLE was last called by idle_wait
         std::array<std::vector<Module*>, NUMBER_OF_DEFINED_EVENTS> hooks; // When a module asks to be called for a specific event ( a hook ), this is where that request is remembered
+        std::vector<GcodeRoute> gcode_routes;     // Which ON_GCODE_RECEIVED listeners take which codes, sorted by code then listener
+        std::vector<uint16_t>   gcode_wildcards;  // Listeners that did not say which codes they take, they get every gcode
+
+        std::vector<ConsoleRoute> console_routes; // Which modules take which console commands, sorted by command
+
+        uint16_t gcode_listener(Module* module);
+        void dispatch_gcode(void* argument);
+        void route_console_line(void* argument);
 
 };
 
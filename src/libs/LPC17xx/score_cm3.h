@@ -517,6 +517,11 @@ static __INLINE void __ISB()                      { __ASM volatile ("isb"); }
 static __INLINE void __DSB()                      { __ASM volatile ("dsb"); }
 static __INLINE void __DMB()                      { __ASM volatile ("dmb"); }
 static __INLINE void __CLREX()                    { __ASM volatile ("clrex"); }
+
+/* mbed's core_cmFunc.h has it too, when its LPC17xx.h was included first */
+#ifndef __CORE_CMFUNC_H
+static __INLINE uint32_t __get_PRIMASK()          { uint32_t result; __ASM volatile ("mrs %0, primask" : "=r" (result)); return result; }
+#endif
 
 
 #elif (defined (__TASKING__)) /*------------------ TASKING Compiler ---------------------*/
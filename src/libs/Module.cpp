@@ -7,6 +7,7 @@
 
 #include "libs/Module.h"
 #include "libs/Kernel.h"
+#include <algorithm>
 
 // Events are the basic building blocks of Smoothie. They register for events, and then do stuff when those events are called.
 // You add things to Smoothie by making a new class that inherits the Module class. See http://smoothieware.org/moduleexample for a crude introduction
@@ -17,7 +18,8 @@ const ModuleCallback kernel_callback_functions[NUMBER_OF_DEFINED_EVENTS] = {
     #undef EVENT
 };
 
-Module::Module(){}
+Module::Module(){
+}
 Module::~Module(){}
 
 void Module::on_module_loaded(){}
@@ -26,6 +28,34 @@ void Module::register_for_event(_EVENT_ENUM event_id){
     this->kernel->register_for_event(event_id, this);
 }
 
+// Only get ON_GCODE_RECEIVED for these G or M codes, see Kernel::register_for_gcode
+void Module::register_for_gcode(char letter, unsigned int code){
+    this->kernel->register_for_gcode(this, letter, code);
+}
+
+// Only get ON_CONSOLE_LINE_RECEIVED for lines starting with this command, see Kernel::route_console_line
+void Module::register_for_command(uint16_t command){
+    this->kernel->register_for_command(this, command);
+}
+
+// A setting's key in config_keys : exact for one and two word settings, the third checksum is mixed in for the rest
+static inline uint32_t config_key(const uint16_t check_sums[3]){
+    return ( ( (uint32_t)check_sums[0] << 16 ) | check_sums[1] ) ^ ( (uint32_t)check_sums[2] * 0x9E3779B1 );
+}
+
+// Config tells us each setting we read while we load our config
+void Module::note_config_read(const uint16_t check_sums[3]){
+    uint32_t key = config_key(check_sums);
+    std::vector<uint32_t>::iterator place = std::lower_bound(this->config_keys.begin(), this->config_keys.end(), key);
+    if( place != this->config_keys.end() && *place == key ){ return; }
+    this->config_keys.insert(place, key);
+}
+
+// Whether this module uses this setting, false positives ( three word settings with the same key ) only cost an unneeded reload
+bool Module::reads_config(const uint16_t check_sums[3]){
+    return std::binary_search(this->config_keys.begin(), this->config_keys.end(), config_key(check_sums));
+}
+
 #define EVENT(name, func) void Module::func (void*) {}
 #include "Event.h"
 #undef EVENT
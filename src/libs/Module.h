@@ -8,8 +8,10 @@
 #ifndef MODULE_H
 #define MODULE_H
 
+#include <stdint.h>
 #include <string>
 using std::string;
+#include <vector>
 
 // See : http://smoothieware.org/listofevents
 
@@ -35,10 +37,15 @@ class Module {
         virtual ~Module();
         virtual void on_module_loaded();
         void register_for_event(        _EVENT_ENUM event_id);
+        void register_for_gcode(char letter, unsigned int code);
+        void register_for_command(uint16_t command);
+        void note_config_read(const uint16_t check_sums[3]);
+        bool reads_config(const uint16_t check_sums[3]);
         #define EVENT(name, func) virtual void func (void*);
         #include "Event.h"
         #undef EVENT
         Kernel * kernel;
+        std::vector<uint32_t> config_keys; // The settings this module read when it last loaded its config, as sorted keys, see Kernel::reload_config
 };
 
 #endif
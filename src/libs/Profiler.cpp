@@ -0,0 +1,63 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Profiler.h"
+#include "libs/StreamOutput.h"
+#if defined(TARGET_LPC1768)
+#include "system_LPC17xx.h"
+#endif
+
+// Zeroed before any constructor runs, so zones in any file can add themselves
+ProfileZone* ProfileZone::first;
+
+ProfileZone::ProfileZone(const char* name){
+    this->name = name;
+    this->reset();
+    this->next = ProfileZone::first;
+    ProfileZone::first = this;
+}
+
+void ProfileZone::reset(){
+    this->count = 0;
+    this->min   = 0xFFFFFFFF;
+    this->max   = 0;
+    this->total = 0;
+}
+
+// The cycle counter is off after reset, unless a debugger turned it on
+void ProfileZone::start_counter(){
+#if defined(TARGET_LPC1768)
+    PROFILE_DEMCR |= (1 << 24);         // TRCENA, powers the DWT
+    PROFILE_DWT_CYCCNT = 0;
+    PROFILE_DWT_CTRL |= (1 << 0);       // CYCCNTENA
+#endif
+}
+
+// Print every zone that ran since the last reset, for the "profile" console command
+void ProfileZone::report(StreamOutput* stream){
+#if defined(TARGET_LPC1768)
+    uint32_t per_us = SystemCoreClock / 1000000;
+    stream->printf("zone                     count       min(cy)  avg(cy)  max(cy)  avg(us)\r\n");
+#else
+    uint32_t per_us = 1000;
+    stream->printf("zone                     count       min(ns)  avg(ns)  max(ns)  avg(us)\r\n");
+#endif
+    for( ProfileZone* zone = ProfileZone::first; zone != 0; zone = zone->next ){
+        if( zone->count == 0 || zone->name == 0 ){ continue; }
+        uint32_t count   = zone->count;
+        uint32_t average = (uint32_t)(zone->total / count);
+        stream->printf("%-24s %-11lu %-8lu %-8lu %-8lu %lu.%02lu\r\n", zone->name, (unsigned long)count,
+                       (unsigned long)zone->min, (unsigned long)average, (unsigned long)zone->max,
+                       (unsigned long)(average / per_us), (unsigned long)((average % per_us) * 100 / per_us));
+    }
+}
+
+void ProfileZone::reset_all(){
+    for( ProfileZone* zone = ProfileZone::first; zone != 0; zone = zone->next ){
+        zone->reset();
+    }
+}
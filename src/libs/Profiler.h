@@ -0,0 +1,78 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+#if defined(TARGET_LPC1768)
+// The Cortex-M3 debug registers, by address : sLPC17xx.h, which most files include before LPC17xx.h, does not define them
+#define PROFILE_DWT_CTRL    (*(volatile uint32_t*)0xE0001000)
+#define PROFILE_DWT_CYCCNT  (*(volatile uint32_t*)0xE0001004)
+#define PROFILE_DEMCR       (*(volatile uint32_t*)0xE000EDFC)
+#else
+#include <time.h>
+#endif
+
+class StreamOutput;
+
+// Profiling zones : how many times a piece of code ran, and how many cycles it took at least, on average and at most
+// On the board cycles are read from the DWT cycle counter, which costs a single load. A host build counts nanoseconds from clock_gettime instead
+// Zones are static objects, each adds itself to the list the "profile" console command prints
+
+static inline uint32_t profile_cycles(){
+#if defined(TARGET_LPC1768)
+    return PROFILE_DWT_CYCCNT;
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)now.tv_sec * 1000000000u + (uint32_t)now.tv_nsec;
+#endif
+}
+
+class ProfileZone {
+    public:
+        ProfileZone(const char* name = 0);
+
+        // Zones are filled from interrupts too : a report may see a sample half added, which is fine for what it is used for
+        void add(uint32_t cycles){
+            this->count++;
+            this->total += cycles;
+            if( cycles < this->min ){ this->min = cycles; }
+            if( cycles > this->max ){ this->max = cycles; }
+        }
+        void reset();
+
+        static void start_counter();
+        static void report(StreamOutput* stream);
+        static void reset_all();
+
+        const char*  name;
+        uint32_t     count;
+        uint32_t     min;
+        uint32_t     max;
+        uint64_t     total;
+
+    private:
+        ProfileZone(const ProfileZone&);            // Zones are in the list by address, they can't be copied
+        ProfileZone* next;
+        static ProfileZone* first;
+};
+
+// Adds the time until the end of the enclosing scope to a zone
+class ProfileScope {
+    public:
+        ProfileScope(ProfileZone& zone) : zone(zone), start(profile_cycles()) {}
+        ~ProfileScope(){ this->zone.add(profile_cycles() - this->start); }
+
+    private:
+        ProfileZone& zone;
+        uint32_t     start;
+};
+
+#endif
@@ -25,6 +25,16 @@ int SDFAT::disk_write(const char *buffer, int sector)
     return d->disk_write(buffer, sector);
 }
 
+int SDFAT::disk_read_sectors(char *buffer, int sector, int count)
+{
+    return d->disk_read_blocks(buffer, sector, count);
+}
+
+int SDFAT::disk_write_sectors(const char *buffer, int sector, int count)
+{
+    return d->disk_write_blocks(buffer, sector, count);
+}
+
 int SDFAT::disk_sync()
 {
     return d->disk_sync();
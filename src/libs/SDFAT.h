@@ -12,6 +12,8 @@ public:
     virtual int disk_status();
     virtual int disk_read(char *buffer, int sector);
     virtual int disk_write(const char *buffer, int sector);
+    virtual int disk_read_sectors(char *buffer, int sector, int count);
+    virtual int disk_write_sectors(const char *buffer, int sector, int count);
     virtual int disk_sync();
     virtual int disk_sectors();
 
@@ -0,0 +1,156 @@
+#include "SectorCache.h"
+
+#include "ahbmalloc.h"
+#include "LPC17xx.h"
+
+#include <string.h>
+
+SectorCache::SectorCache(MSD_Disk *disk)
+{
+    d = disk;
+    // Without the memory we just pass everything through
+    buffer = (char *) ahbmalloc(SECTOR_CACHE_SIZE * 512, AHB_BANK_1);
+    for (int i = 0; i < SECTOR_CACHE_SIZE; i++) {
+        blocks[i] = 0;
+        loading[i] = 0;
+    }
+    invalidate();
+}
+
+// The cache is shared by the main loop ( FatFs ) and the USB interrupt ( USB MSD ), so the slot bookkeeping is done with interrupts off
+// A slot being read into is marked loading, so the other side neither uses nor reuses it until the read is over
+
+void SectorCache::invalidate()
+{
+    __disable_irq();
+    for (int i = 0; i < SECTOR_CACHE_SIZE; i++) {
+        used[i] = 0;
+        // whoever is reading into it will not keep what it reads
+        if (loading[i])
+            loading[i] = SECTOR_STALE;
+    }
+    clock = 0;
+    __enable_irq();
+}
+
+int SectorCache::find(uint32_t block)
+{
+    if (buffer == NULL)
+        return -1;
+    for (int i = 0; i < SECTOR_CACHE_SIZE; i++) {
+        if (used[i] && !loading[i] && blocks[i] == block)
+            return i;
+    }
+    return -1;
+}
+
+// Least recently used slot, or an empty one, -1 if they are all being read into
+int SectorCache::victim()
+{
+    int oldest = -1;
+    for (int i = 0; i < SECTOR_CACHE_SIZE; i++) {
+        if (loading[i])
+            continue;
+        if (used[i] == 0)
+            return i;
+        if (oldest < 0 || used[i] < used[oldest])
+            oldest = i;
+    }
+    return oldest;
+}
+
+int SectorCache::disk_read(char *data, uint32_t block)
+{
+    __disable_irq();
+    int i = find(block);
+    if (i >= 0) {
+        memcpy(data, buffer + (i * 512), 512);
+        used[i] = ++clock;
+        __enable_irq();
+        return 0;
+    }
+
+    if (buffer != NULL)
+        i = victim();
+    if (i >= 0) {
+        used[i] = 0;
+        blocks[i] = block;
+        loading[i] = SECTOR_LOADING;
+    }
+    __enable_irq();
+
+    if (i < 0)
+        return d->disk_read(data, block);
+
+    // Read into the cache, it is in AHB ram so the disk can DMA there
+    int res = d->disk_read(buffer + (i * 512), block);
+    if (res == 0)
+        memcpy(data, buffer + (i * 512), 512);
+
+    // Only keep what was really read, and not changed under us by a write or a new card
+    __disable_irq();
+    if (res == 0 && loading[i] == SECTOR_LOADING)
+        used[i] = ++clock;
+    loading[i] = 0;
+    __enable_irq();
+    return res;
+}
+
+int SectorCache::disk_write(const char *data, uint32_t block)
+{
+    int res = d->disk_write(data, block);
+    __disable_irq();
+    for (int i = 0; i < SECTOR_CACHE_SIZE; i++) {
+        if (blocks[i] != block)
+            continue;
+        if (loading[i])
+            loading[i] = SECTOR_STALE;
+        else if (used[i] && res)
+            used[i] = 0;
+        else if (used[i])
+            memcpy(buffer + (i * 512), data, 512);
+    }
+    __enable_irq();
+    return res;
+}
+
+int SectorCache::disk_read_blocks(char *data, uint32_t block, uint32_t count)
+{
+    if (count == 1)
+        return disk_read(data, block);
+    // The cache is never dirty, so the disk is up to date
+    return d->disk_read_blocks(data, block, count);
+}
+
+int SectorCache::disk_write_blocks(const char *data, uint32_t block, uint32_t count)
+{
+    if (count == 1)
+        return disk_write(data, block);
+
+    int res = d->disk_write_blocks(data, block, count);
+    __disable_irq();
+    for (int i = 0; i < SECTOR_CACHE_SIZE; i++) {
+        if (blocks[i] >= block && blocks[i] < block + count) {
+            used[i] = 0;
+            if (loading[i])
+                loading[i] = SECTOR_STALE;
+        }
+    }
+    __enable_irq();
+    return res;
+}
+
+// A new card may have been inserted
+int SectorCache::disk_initialize()
+{
+    invalidate();
+    return d->disk_initialize();
+}
+
+uint32_t SectorCache::disk_sectors()    { return d->disk_sectors(); }
+uint64_t SectorCache::disk_size()       { return d->disk_size(); }
+uint32_t SectorCache::disk_blocksize()  { return d->disk_blocksize(); }
+int SectorCache::disk_status()          { return d->disk_status(); }
+bool SectorCache::disk_canDMA()         { return d->disk_canDMA(); }
+int SectorCache::disk_sync()            { return d->disk_sync(); }
+bool SectorCache::busy()                { return d->busy(); }
@@ -0,0 +1,47 @@
+#ifndef _SECTORCACHE_H
+#define _SECTORCACHE_H
+
+#include "disk.h"
+
+// Sectors kept in AHB ram, 512 bytes each
+#define SECTOR_CACHE_SIZE 8
+
+// What is happening to a slot that is being read into
+#define SECTOR_LOADING  1       // the read will be kept
+#define SECTOR_STALE    2       // the sector was written or the card changed during the read, it won't be kept
+
+// Keeps the most recently used single sectors of a disk ( FAT, directories, the partial sectors at either end of a read ) in AHB ram
+// Runs of sectors go straight to the disk : they are file data that would only push the useful sectors out
+// Writes go through to the disk, so the cache is never dirty and can sit under both FatFs and USB MSD
+class SectorCache : public MSD_Disk {
+public:
+    SectorCache(MSD_Disk *disk);
+
+    virtual int disk_read(char *data, uint32_t block);
+    virtual int disk_write(const char *data, uint32_t block);
+    virtual int disk_read_blocks(char *data, uint32_t block, uint32_t count);
+    virtual int disk_write_blocks(const char *data, uint32_t block, uint32_t count);
+    virtual int disk_initialize();
+    virtual uint32_t disk_sectors();
+    virtual uint64_t disk_size();
+    virtual uint32_t disk_blocksize();
+    virtual int disk_status();
+    virtual bool disk_canDMA();
+    virtual int disk_sync();
+    virtual bool busy();
+
+    void invalidate();
+
+protected:
+    int find(uint32_t block);
+    int victim();
+
+    MSD_Disk *d;
+    char *buffer;
+    uint32_t blocks[SECTOR_CACHE_SIZE];
+    uint32_t used[SECTOR_CACHE_SIZE];      // when the sector was last used, 0 for an empty slot
+    uint8_t loading[SECTOR_CACHE_SIZE];    // SECTOR_LOADING or SECTOR_STALE while a read fills the slot, 0 otherwise
+    uint32_t clock;
+};
+
+#endif /* _SECTORCACHE_H */
@@ -1,8 +1,14 @@
 #ifndef SERIALMESSAGE_H
 #define SERIALMESSAGE_H
 #include "libs/StreamOutput.h"
+
+// Console streams keep one message and reuse it for every line they receive, with this much room reserved once,
+// so lines don't go through the heap. Modules that get a message must not keep a pointer to it
+#define SERIAL_MESSAGE_RESERVE 128
+
 struct SerialMessage {
         StreamOutput* stream;
         std::string message;
+        uint16_t command;       // Checksum of the command word, set by Kernel::route_console_line for shell command lines
 };
 #endif
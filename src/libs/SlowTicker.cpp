@@ -15,82 +15,170 @@ using namespace std;
 #include "modules/robot/Conveyor.h"
 
 #include <mri.h>
+#include "libs/Profiler.h"
 
 // This module uses a Timer to periodically call hooks
 // Modules register with a function ( callback ) and a frequency, and we then call that function at the given frequency.
 
+// Signed difference of two timer counts, so comparisons survive the counter wrapping
+#define TICKS_UNTIL(deadline, now) ((int32_t)((deadline) - (now)))
+
 SlowTicker* global_slow_ticker;
 
 SlowTicker::SlowTicker(){
-    max_frequency = 0;
     global_slow_ticker = this;
+    this->first_hook = NULL;
 
-    // Configure the actual timer
+    // Configure the actual timer, it runs free at SystemCoreClock/4 and MR0 follows the next deadline
     LPC_SC->PCONP |= (1 << 22);     // Power Ticker ON
+    LPC_TIM2->PR  = 0;
     LPC_TIM2->MR0 = 10000;          // Initial dummy value for Match Register
-    LPC_TIM2->MCR = 3;              // Match on MR0, reset on MR0
-    LPC_TIM2->TCR = 1;              // Enable interrupt
+    LPC_TIM2->MCR = 1;              // Interrupt on MR0, no reset
+    LPC_TIM2->TCR = 2;              // Reset
+    LPC_TIM2->TCR = 1;              // Enable
     NVIC_EnableIRQ(TIMER2_IRQn);    // Enable interrupt handler
 
     // ISP button
     ispbtn.from_string("2.10")->as_input()->pull_up();
 
-    // TODO: What is this ??
     flag_1s_flag = 0;
-    flag_1s_count = SystemCoreClock>>2;
+    this->tenths = 0;
 
     g4_ticks = 0;
     g4_pause = false;
+    g4_last = 0;
+
+    // Our own work : the one second flag and the ISP button
+    this->attach(10, this, &SlowTicker::housekeeping_tick);
 }
 
 void SlowTicker::on_module_loaded(){
     register_for_event(ON_IDLE);
     register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('G', 4);
     register_for_event(ON_GCODE_EXECUTE);
 }
 
-// Set the base frequency we use for all sub-frequencies
-void SlowTicker::set_frequency( int frequency ){
-    this->interval = (SystemCoreClock >> 2) / frequency;   // SystemCoreClock/4 = Timer increments in a second
-    LPC_TIM2->MR0 = this->interval;
-    LPC_TIM2->TCR = 3;  // Reset
-    LPC_TIM2->TCR = 1;  // Reset
-    flag_1s_count= SystemCoreClock>>2;
+// Start calling a new hook
+// A hook with the same interval as one we already have gets the same deadlines, so they are dealt with in the same interrupt
+void SlowTicker::add_hook(Hook* hook, uint32_t frequency){
+    hook->interval = (SystemCoreClock >> 2) / frequency;   // SystemCoreClock/4 = Timer increments in a second
+    hook->deadline = LPC_TIM2->TC + hook->interval;
+
+    __disable_irq();
+    for( Hook* other = this->first_hook; other != NULL; other = other->next ){
+        if( other->interval == hook->interval ){
+            hook->deadline = other->deadline;
+            break;
+        }
+    }
+    this->insert(hook);
+    this->schedule();
+    __enable_irq();
+}
+
+// Stop calling a hook, and free it
+void SlowTicker::detach(Hook* hook){
+    __disable_irq();
+    this->remove(hook);
+    this->schedule();
+    __enable_irq();
+    delete hook;
+}
+
+// Set how often a hook is called, modules use this to change the frequency of a hook they attached earlier rather than attaching another
+void SlowTicker::set_hook_frequency(Hook* hook, uint32_t frequency){
+    __disable_irq();
+    this->remove(hook);
+    hook->interval = (SystemCoreClock >> 2) / frequency;
+    hook->deadline = LPC_TIM2->TC + hook->interval;
+    this->insert(hook);
+    this->schedule();
+    __enable_irq();
+}
+
+// Call a hook as soon as this interrupt ( or the caller ) is done, and every interval from now on
+// Stepper uses this to keep acceleration ticks in phase with the blocks
+void SlowTicker::restart(Hook* hook){
+    __disable_irq();
+    this->remove(hook);
+    hook->deadline = LPC_TIM2->TC;
+    this->insert(hook);
+    __enable_irq();
+    NVIC_SetPendingIRQ(TIMER2_IRQn);
+}
+
+// Link a hook in deadline order, interrupts must be off as the step interrupt can restart() a hook while we walk the list
+// Frequent hooks have the soonest deadlines, so they only walk the start of the list
+void SlowTicker::insert(Hook* hook){
+    uint32_t now = LPC_TIM2->TC;
+    Hook** link = &this->first_hook;
+    while( *link != NULL && TICKS_UNTIL((*link)->deadline, now) <= TICKS_UNTIL(hook->deadline, now) ){
+        link = &(*link)->next;
+    }
+    hook->next = *link;
+    *link = hook;
+}
+
+void SlowTicker::remove(Hook* hook){
+    for( Hook** link = &this->first_hook; *link != NULL; link = &(*link)->next ){
+        if( *link == hook ){
+            *link = hook->next;
+            hook->next = NULL;
+            return;
+        }
+    }
+}
+
+// Point MR0 at the soonest deadline, if it already passed make sure the interrupt still happens
+void SlowTicker::schedule(){
+    if( this->first_hook == NULL ){ return; }
+    LPC_TIM2->MR0 = this->first_hook->deadline;
+    if( TICKS_UNTIL(this->first_hook->deadline, LPC_TIM2->TC) <= 0 ){
+        NVIC_SetPendingIRQ(TIMER2_IRQn);
+    }
 }
 
 // The actual interrupt being called by the timer, this is where work is done
+static ProfileZone slow_ticker_zone("slow_ticker_hook");
+
 void SlowTicker::tick(){
 
-    // Call all hooks that need to be called ( bresenham )
-    for (uint32_t i=0; i<this->hooks.size(); i++){
-        Hook* hook = this->hooks.at(i);
-        hook->countdown -= this->interval;
-        if (hook->countdown < 0)
-        {
-            hook->countdown += hook->interval;
-            hook->call();
+    // Call the hooks that are due, each one goes back in the list at its next deadline
+    // The list is only touched with interrupts off, the step interrupt preempts us and can restart() a hook at any time
+    while( true ){
+        __disable_irq();
+        Hook* hook = this->first_hook;
+        if( hook == NULL ){ __enable_irq(); break; }
+        uint32_t now = LPC_TIM2->TC;
+        if( TICKS_UNTIL(hook->deadline, now) > 0 ){
+            LPC_TIM2->MR0 = hook->deadline;
+            // The deadline may have passed while we were setting MR0, the match would then only happen once the counter wraps
+            bool waiting = TICKS_UNTIL(hook->deadline, LPC_TIM2->TC) > 0;
+            __enable_irq();
+            if( waiting ){ break; }
+            continue;
         }
-    }
 
-    // deduct tick time from secound counter
-    flag_1s_count -= this->interval;
-    // if a whole second has elapsed,
-    if (flag_1s_count < 0)
-    {
-        // add a second to our counter
-        flag_1s_count += SystemCoreClock >> 2;
-        // and set a flag for idle event to pick up
-        flag_1s_flag++;
+        this->first_hook = hook->next;
+        hook->deadline += hook->interval;
+        // If we fell more than an interval behind, skip the calls we missed rather than making them all now
+        if( TICKS_UNTIL(hook->deadline, now) <= 0 ){ hook->deadline = now + hook->interval; }
+        this->insert(hook);
+        __enable_irq();
+
+        uint32_t start = profile_cycles();
+        hook->call();
+        slow_ticker_zone.add(profile_cycles() - start);
     }
+}
 
-    // if we're counting down a pause
-    if (g4_ticks > 0)
-    {
-        // deduct tick time from timeout
-        if (g4_ticks > interval)
-            g4_ticks -= interval;
-        else
-            g4_ticks = 0;
+// Ten times a second
+uint32_t SlowTicker::housekeeping_tick(uint32_t dummy){
+    // Set a flag every second for the idle event to pick up
+    if( ++this->tenths >= 10 ){
+        this->tenths = 0;
+        flag_1s_flag++;
     }
 
     // Enter MRI mode if the ISP button is pressed
@@ -98,6 +186,7 @@ void SlowTicker::tick(){
     if (ispbtn.get() == 0)
         __debugbreak();
 
+    return 0;
 }
 
 bool SlowTicker::flag_1s(){
@@ -134,11 +223,22 @@ void SlowTicker::on_idle(void*)
         // fire the on_second_tick event
         kernel->call_event(ON_SECOND_TICK);
 
-    // if G4 has finished, release our pause
-    if (g4_pause && (g4_ticks == 0))
+    // if we're counting down a pause, take off the time since we last looked, and release it once it is over
+    if (g4_pause)
     {
-        g4_pause = false;
-        kernel->pauser->release();
+        uint32_t now = LPC_TIM2->TC;
+        uint32_t elapsed = now - g4_last;
+        g4_last = now;
+        if (g4_ticks > elapsed)
+            g4_ticks -= elapsed;
+        else
+            g4_ticks = 0;
+
+        if (g4_ticks == 0)
+        {
+            g4_pause = false;
+            kernel->pauser->release();
+        }
     }
 }
 
@@ -164,6 +264,10 @@ void SlowTicker::on_gcode_execute(void* argument){
         if (gcode->g == 4){
             gcode->mark_as_taken();
             bool updated = false;
+            if (!g4_pause) {
+                g4_ticks = 0;
+                g4_last = LPC_TIM2->TC;
+            }
             if (gcode->has_letter('P')) {
                 updated = true;
                 g4_ticks += gcode->get_int('P') * ((SystemCoreClock >> 2) / 1000UL);
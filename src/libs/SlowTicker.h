@@ -10,8 +10,6 @@
 #ifndef SLOWTICKER_H
 #define SLOWTICKER_H
 
-using namespace std;
-#include <vector>
 #include "libs/nuts_bolts.h"
 #include "libs/Module.h"
 #include "libs/Kernel.h"
@@ -22,6 +20,8 @@ using namespace std;
 #include "system_LPC17xx.h" // for SystemCoreClock
 #include <math.h>
 
+// Calls hooks at the frequencies they asked for, from the TIMER2 interrupt
+// TIMER2 runs free, hooks are kept in order of their next deadline and MR0 is set to the soonest one, so an interrupt only deals with the hooks that are due
 class SlowTicker : public Module{
     public:
         SlowTicker();
@@ -31,39 +31,38 @@ class SlowTicker : public Module{
         void on_gcode_received(void*);
         void on_gcode_execute(void*);
 
-        void set_frequency( int frequency );
         void tick();
         // For some reason this can't go in the .cpp, see :  http://mbed.org/forum/mbed/topic/2774/?page=1#comment-14221
         template<typename T> Hook* attach( uint32_t frequency, T *optr, uint32_t ( T::*fptr )( uint32_t ) ){
             Hook* hook = new Hook();
-            hook->interval = int(floor((SystemCoreClock/4)/frequency));
             hook->attach(optr, fptr);
-            hook->countdown = hook->interval;
-            if( frequency > this->max_frequency ){
-                this->max_frequency = frequency;
-                this->set_frequency(frequency);
-            }
-            this->hooks.push_back(hook);
+            this->add_hook(hook, frequency);
             return hook;
         }
+        void detach(Hook* hook);
+        void set_hook_frequency(Hook* hook, uint32_t frequency);
+        void restart(Hook* hook);
 
         bool flag_1s();
 
-        vector<Hook*> hooks;
-        uint32_t max_frequency;
-        uint32_t interval;
-
         uint32_t g4_ticks;
         bool     g4_pause;
 
         Pin ispbtn;
-protected:
-    int flag_1s_count;
-    volatile int flag_1s_flag;
-};
-
 
+    private:
+        void add_hook(Hook* hook, uint32_t frequency);
+        void insert(Hook* hook);
+        void remove(Hook* hook);
+        void schedule();
+        uint32_t housekeeping_tick(uint32_t dummy);
 
+        Hook*    first_hook;        // Hook with the soonest deadline, they are linked in deadline order
+        uint32_t g4_last;           // Timer count when on_idle last took elapsed time off g4_ticks
+        int      tenths;
 
+protected:
+    volatile int flag_1s_flag;
+};
 
 #endif
@@ -0,0 +1,100 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SMALLSTRING_H
+#define SMALLSTRING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+using std::string;
+
+class StreamOutput;
+
+// How often strings did not fit their inline buffer, for the "mem" console command
+struct SmallStringStats {
+    uint32_t spills;        // Times a string had to take its text to the heap
+    uint16_t longest;       // Longest string that went to the heap
+
+    void report(StreamOutput* stream);
+};
+extern SmallStringStats small_string_stats;
+
+// A string that keeps up to N-1 characters inside itself, so making, copying and dropping one never touches the heap
+// Longer text ( a raster scanline, a long M117 message ) still works : it goes to the heap, and is counted in small_string_stats
+// Only what Gcode needs of std::string is here
+template <size_t N>
+class SmallString {
+    public:
+        SmallString() : text(inline_text), len(0), capacity(N) { inline_text[0] = '\0'; }
+        SmallString(const SmallString& to_copy) : text(inline_text), len(0), capacity(N) { this->assign(to_copy.text, to_copy.len); }
+        ~SmallString(){ if( this->text != this->inline_text ){ free(this->text); } }
+
+        SmallString& operator= (const SmallString& to_copy){
+            if( this != &to_copy ){ this->assign(to_copy.text, to_copy.len); }
+            return *this;
+        }
+
+        void assign(const char* s, size_t n){
+            this->len = 0;
+            this->append(s, n);
+        }
+        void assign(const string& s){ this->assign(s.data(), s.size()); }
+
+        void append(const char* s, size_t n){
+            if( !this->reserve(this->len + n) ){ n = this->capacity - 1 - this->len; }
+            memcpy(this->text + this->len, s, n);
+            this->len += n;
+            this->text[this->len] = '\0';
+        }
+        void append(const char* s){ this->append(s, strlen(s)); }
+
+        void clear(){ this->len = 0; this->text[0] = '\0'; }
+
+        // Same as std::string::compare( pos, n, s ), enough to tell whether the string starts with s
+        int compare(size_t pos, size_t n, const string& s) const {
+            if( pos > this->len ){ pos = this->len; }
+            if( n > this->len - pos ){ n = this->len - pos; }
+            size_t shortest = n < s.size() ? n : s.size();
+            int r = memcmp(this->text + pos, s.data(), shortest);
+            if( r != 0 ){ return r; }
+            return n < s.size() ? -1 : ( n > s.size() ? 1 : 0 );
+        }
+
+        const char* c_str() const { return this->text; }
+        const char* data() const { return this->text; }
+        size_t length() const { return this->len; }
+        size_t size() const { return this->len; }
+        bool empty() const { return this->len == 0; }
+        char at(size_t i) const { return this->text[i]; }
+        char operator[](size_t i) const { return this->text[i]; }
+
+    private:
+        // Make room for n characters, moving to the heap when they don't fit inline. Returns false if the heap is out
+        bool reserve(size_t n){
+            if( n < this->capacity ){ return true; }
+            size_t wanted = ( n + 16 ) & ~15;
+            char* grown = (char*)( this->text == this->inline_text ? malloc(wanted) : realloc(this->text, wanted) );
+            if( grown == NULL ){ return false; }
+            if( this->text == this->inline_text ){
+                memcpy(grown, this->inline_text, this->len + 1);
+                small_string_stats.spills++;
+            }
+            this->text = grown;
+            this->capacity = wanted;
+            if( n > small_string_stats.longest ){ small_string_stats.longest = n; }
+            return true;
+        }
+
+        char*    text;              // inline_text, or the heap for long text
+        uint16_t len;
+        uint16_t capacity;
+        char     inline_text[N];
+};
+
+#endif
@@ -16,6 +16,9 @@ using namespace std;
 #include "system_LPC17xx.h" // mbed.h lib
 
 #include <mri.h>
+#include "libs/Profiler.h"
+#include "libs/StreamOutput.h"
+#include <string.h>
 
 // StepTicker handles the base frequency ticking for the Stepper Motors / Actuators
 // It has a list of those, and calls their tick() functions at regular intervals
@@ -48,6 +51,7 @@ StepTicker::StepTicker(){
         this->active_motors[i] = NULL;
     }
     this->active_motor_bm = 0;
+    this->reset_stats();
 
     NVIC_EnableIRQ(TIMER0_IRQn);     // Enable interrupt handler
     NVIC_EnableIRQ(TIMER1_IRQn);     // Enable interrupt handler
@@ -132,12 +136,23 @@ inline void StepTicker::reset_tick(){
 }
 
 extern "C" void TIMER1_IRQHandler (void){
+    // TIMER1 is restarted at each step and keeps counting, so how far it is past the match is how late we are
+    uint32_t late = LPC_TIM1->TC - LPC_TIM1->MR0;
     LPC_TIM1->IR |= 1 << 0;
     global_step_ticker->reset_tick();
+
+    StepTickerStats& stats = global_step_ticker->stats;
+    stats.resets++;
+    if( late > stats.reset_latency_max ){ stats.reset_latency_max = late; }
+    uint32_t bin = 0;
+    for( uint32_t limit = SystemCoreClock / 4000000; late >= limit && bin < STEP_STATS_BINS - 1; limit <<= 1 ){ bin++; }
+    stats.reset_latency_histogram[bin]++;
 }
 
+static ProfileZone step_isr_zone("step_isr");
+
 // The actual interrupt handler where we do all the work
-extern "C" void TIMER0_IRQHandler (void){
+static inline void step_tick(){
 
     // Reset interrupt register
     LPC_TIM0->IR |= 1 << 0;
@@ -168,7 +183,13 @@ extern "C" void TIMER0_IRQHandler (void){
         // Do not get out of here before everything is nice and tidy
         LPC_TIM0->MR0 = 20000000;
         
+        uint32_t block_start = profile_cycles();
         global_step_ticker->signal_moves_finished();
+        uint32_t block_duration = profile_cycles() - block_start;
+        StepTickerStats& stats = global_step_ticker->stats;
+        stats.block_changes++;
+        stats.block_change_total += block_duration;
+        if( block_duration > stats.block_change_max ){ stats.block_change_max = block_duration; }
 
         // If we went over the duration an interrupt is supposed to last, we have a problem
         // That can happen tipically when we change blocks, where more than usual computation is done
@@ -194,6 +215,8 @@ extern "C" void TIMER0_IRQHandler (void){
                             );
             }
 
+            global_step_ticker->stats.skipped_ticks += ticks_we_actually_can_skip;
+
             // Adding to MR0 for this time is not enough, we must also increment the counters ourself artificially
             for (i = 0, bm = 1; i < 12; i++, bm <<= 1)
             {
@@ -221,6 +244,53 @@ extern "C" void TIMER0_IRQHandler (void){
 }
 
 
+// Time each tick, for the profile and the step statistics
+extern "C" void TIMER0_IRQHandler (void){
+    uint32_t start = profile_cycles();
+    step_tick();
+    uint32_t duration = profile_cycles() - start;
+    step_isr_zone.add(duration);
+
+    // Ticks that step nothing return early and tell us nothing
+    if( !global_step_ticker->active_motor_bm ){ return; }
+    StepTickerStats& stats = global_step_ticker->stats;
+    stats.ticks++;
+    if( duration > stats.duration_max ){ stats.duration_max = duration; }
+
+    // The period is in timer ticks of 4 cycles, so this is the duration in quarters of the period
+    uint32_t quarters = duration / global_step_ticker->period;
+    if( quarters >= 4 ){ stats.overruns++; }
+    stats.duration_histogram[quarters < STEP_STATS_BINS ? quarters : STEP_STATS_BINS - 1]++;
+}
+
+// Print the step statistics. The interrupts keep running : we print from a copy, which may mix counts from two ticks
+void StepTicker::report_stats(StreamOutput* stream){
+    StepTickerStats copy;
+    memcpy(&copy, (const void*)&this->stats, sizeof(copy));
+
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
+    uint32_t ticks_per_us  = SystemCoreClock / 4000000;
+    stream->printf("base period: %lu cycles, %lu step ticks, %lu overruns, %lu ticks skipped, longest %lu cycles\r\n",
+                   (unsigned long)this->period * 4, (unsigned long)copy.ticks, (unsigned long)copy.overruns, (unsigned long)copy.skipped_ticks, (unsigned long)copy.duration_max);
+    stream->printf("tick duration, by quarter of the period:");
+    for( int i = 0; i < STEP_STATS_BINS; i++ ){ stream->printf(" %lu", (unsigned long)copy.duration_histogram[i]); }
+    stream->printf("\r\n");
+
+    unsigned long average = copy.block_changes == 0 ? 0 : (unsigned long)(copy.block_change_total / copy.block_changes);
+    stream->printf("%lu block changes, average %lu us, longest %lu us\r\n",
+                   (unsigned long)copy.block_changes, average / cycles_per_us, (unsigned long)copy.block_change_max / cycles_per_us);
+
+    stream->printf("%lu step pin resets, at worst %lu us late after the %lu us pulse\r\n",
+                   (unsigned long)copy.resets, (unsigned long)copy.reset_latency_max / ticks_per_us, (unsigned long)this->delay / ticks_per_us);
+    stream->printf("reset latency, < 1 2 4 8 16 32 64 and over us:");
+    for( int i = 0; i < STEP_STATS_BINS; i++ ){ stream->printf(" %lu", (unsigned long)copy.reset_latency_histogram[i]); }
+    stream->printf("\r\n");
+}
+
+void StepTicker::reset_stats(){
+    memset((void*)&this->stats, 0, sizeof(this->stats));
+}
+
 // We make a list of steppers that want to be called so that we don't call them for nothing
 void StepTicker::add_motor_to_active_list(StepperMotor* motor)
 {
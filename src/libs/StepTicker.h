@@ -17,6 +17,26 @@ using namespace std;
 #include "libs/Kernel.h"
 #include "libs/StepperMotor.h"
 
+class StreamOutput;
+
+#define STEP_STATS_BINS 8
+
+// What the step interrupts have been doing, filled from the interrupts and read with "step_stats" or M970
+// Everything is in a fixed struct so reading it costs the interrupts nothing, a report may mix counts from two ticks
+struct StepTickerStats {
+    uint32_t ticks;                                 // Step interrupts that stepped something
+    uint32_t overruns;                              // Ticks that took longer than the base period
+    uint32_t skipped_ticks;                         // Ticks skipped to catch up after a long block change
+    uint32_t duration_max;                          // Longest tick, in cycles
+    uint32_t duration_histogram[STEP_STATS_BINS];   // Tick duration, in quarters of the base period : < 1/4, < 2/4 ... the last bin is 7/4 and over
+    uint32_t block_changes;                         // Ticks where a move finished
+    uint32_t block_change_max;                      // Longest move finishing, in cycles
+    uint64_t block_change_total;
+    uint32_t resets;                                // Step pin reset interrupts
+    uint32_t reset_latency_max;                     // How late the reset came after the pulse width, in timer ticks
+    uint32_t reset_latency_histogram[STEP_STATS_BINS]; // Reset latency : < 1us, < 2us, < 4us ... the last bin is 64us and over
+};
+
 class StepTicker{
     public:
         StepTicker();
@@ -28,6 +48,8 @@ class StepTicker{
         void reset_tick();
         void add_motor_to_active_list(StepperMotor* motor);
         void remove_motor_from_active_list(StepperMotor* motor);
+        void report_stats(StreamOutput* stream);
+        void reset_stats();
 
         double frequency;
         vector<StepperMotor*> stepper_motors;
@@ -43,6 +65,8 @@ class StepTicker{
         StepperMotor* active_motors[12];
         uint32_t active_motor_bm;
 
+        StepTickerStats stats;
+
 };
 
 
@@ -23,6 +23,8 @@ StepperMotor::StepperMotor(){
     this->is_move_finished = false;
     this->signal_step = false;
     this->step_signal_hook = new Hook();
+    this->signal_pixel = false;
+    this->pixel_signal_hook = new Hook();
 }
 
 StepperMotor::StepperMotor(Pin* step, Pin* dir, Pin* en) : step_pin(step), dir_pin(dir), en_pin(en) {
@@ -36,6 +38,8 @@ StepperMotor::StepperMotor(Pin* step, Pin* dir, Pin* en) : step_pin(step), dir_p
     this->is_move_finished = false;
     this->signal_step = false;
     this->step_signal_hook = new Hook();
+    this->signal_pixel = false;
+    this->pixel_signal_hook = new Hook();
 
     set_high_on_debug(en->port_number, en->pin);
 }
@@ -59,6 +63,11 @@ void StepperMotor::step(){
         this->step_signal_hook->call();
     }
 
+    // Do we need to signal this step to the raster ( the hook sets the next step it wants to be called at )
+    if( this->stepped == this->signal_pixel_number && this->signal_pixel ){
+        this->pixel_signal_hook->call();
+    }
+
     // Is this move finished ?
     if( this->stepped == this->steps_to_move ){
         // Mark it as finished, then StepTicker will call signal_mode_finished() 
@@ -117,6 +126,7 @@ void StepperMotor::move( bool direction, unsigned int steps ){
 
     // Do not signal steps until we get instructed to
     this->signal_step = false;
+    this->signal_pixel = false;
 
     // Starting now we are moving
     if( steps > 0 ){
@@ -41,11 +41,21 @@ class StepperMotor {
             this->signal_step = true;
         }
 
+        // Same as above, but kept separate so a tool ( the laser's raster mode ) can follow the steps of a block without taking the Stepper's own signal
+        template<typename T> void attach_signal_pixel(uint32_t step, T *optr, uint32_t ( T::*fptr )( uint32_t ) ){
+            this->pixel_signal_hook->attach(optr, fptr);
+            this->signal_pixel_number = step;
+            this->signal_pixel = true;
+        }
+
         Hook* end_hook;
         Hook* step_signal_hook;
+        Hook* pixel_signal_hook;
 
         bool signal_step;
         uint32_t signal_step_number;
+        bool signal_pixel;
+        uint32_t signal_pixel_number;
 
         StepTicker* step_ticker;
         Pin* step_pin;
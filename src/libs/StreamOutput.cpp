@@ -1,3 +1,198 @@
 #include "StreamOutput.h"
+#include <stdint.h>
+#include <stddef.h>
 
 NullStreamOutput StreamOutput::NullStream;
+
+int StreamOutput::printf(const char* format, ...){
+    va_list args;
+    va_start(args, format);
+    int n = this->vprintf(format, args);
+    va_end(args);
+    return n;
+}
+
+// Collects formatted text, and sends it to the stream a message at a time
+// When a message does not fit, the whole lines collected so far are sent and the rest kept, so the stream only ever gets whole lines
+// ( unless one line is longer than the buffer ), and can drop or interleave output a line at a time
+class PrintfBuffer {
+    public:
+        PrintfBuffer(StreamOutput* stream) : stream(stream), used(0), total(0) {}
+
+        void write(const char* text, size_t length){
+            this->total += length;
+            while( length > 0 ){
+                if( this->used == STREAM_PRINTF_BUFFER_SIZE - 1 ){ this->flush_lines(); }
+                size_t chunk = STREAM_PRINTF_BUFFER_SIZE - 1 - this->used;
+                if( chunk > length ){ chunk = length; }
+                memcpy(this->buffer + this->used, text, chunk);
+                this->used += chunk;
+                text += chunk;
+                length -= chunk;
+            }
+        }
+
+        void pad(char c, int count){
+            while( count-- > 0 ){ this->write(&c, 1); }
+        }
+
+        // Send everything up to the last newline, or the whole buffer if there is none
+        void flush_lines(){
+            size_t end = this->used;
+            while( end > 0 && this->buffer[end - 1] != '\n' ){ end--; }
+            if( end == 0 ){ end = this->used; }
+            char kept = this->buffer[end];
+            this->buffer[end] = '\0';
+            this->stream->puts(this->buffer);
+            this->buffer[end] = kept;
+            memmove(this->buffer, this->buffer + end, this->used - end);
+            this->used -= end;
+        }
+
+        void flush(){
+            if( this->used == 0 ){ return; }
+            this->buffer[this->used] = '\0';
+            this->stream->puts(this->buffer);
+            this->used = 0;
+        }
+
+        StreamOutput* stream;
+        char   buffer[STREAM_PRINTF_BUFFER_SIZE];
+        size_t used;
+        int    total;
+};
+
+// Append a positive number to a conversion specification
+static char* append_number(char* p, int value){
+    char digits[12];
+    int n = 0;
+    do{ digits[n++] = '0' + value % 10; value /= 10; }while( value > 0 );
+    while( n > 0 ){ *p++ = digits[--n]; }
+    return p;
+}
+
+// Same as vsnprintf, but the text goes to the stream in pieces instead of into one buffer
+// Literal text and strings are copied as they are, other conversions are handed one at a time to snprintf, whose output for a single number is short
+int StreamOutput::vprintf(const char* format, va_list args){
+    PrintfBuffer out(this);
+
+    while( *format ){
+        const char* percent = strchr(format, '%');
+        if( percent == NULL ){
+            out.write(format, strlen(format));
+            break;
+        }
+        out.write(format, percent - format);
+        format = percent + 1;
+
+        // Rebuild the conversion specification, with * width and precision replaced by their values
+        char spec[40];
+        char* p = spec;
+        *p++ = '%';
+        bool left = false;
+        while( *format && strchr("-+ #0", *format) ){
+            if( *format == '-' ){ left = true; }
+            if( p < spec + 8 ){ *p++ = *format; }
+            format++;
+        }
+        int width = -1;
+        if( *format == '*' ){
+            width = va_arg(args, int);
+            if( width < 0 ){ left = true; *p++ = '-'; width = -width; }
+            format++;
+        }else if( *format >= '0' && *format <= '9' ){
+            width = 0;
+            while( *format >= '0' && *format <= '9' ){ width = width * 10 + *format++ - '0'; }
+        }
+        if( width >= 0 ){ p = append_number(p, width); }
+        int precision = -1;
+        if( *format == '.' ){
+            format++;
+            precision = 0;
+            if( *format == '*' ){
+                precision = va_arg(args, int);
+                format++;
+            }else{
+                while( *format >= '0' && *format <= '9' ){ precision = precision * 10 + *format++ - '0'; }
+            }
+            if( precision >= 0 ){ *p++ = '.'; p = append_number(p, precision); }
+        }
+        char length = 0;            // 'H' for hh, 'L' for ll or long double, 'l', 'h', 'z', 'j' or 't'
+        if( *format == 'h' || *format == 'l' ){
+            length = *format;
+            *p++ = *format++;
+            if( *format == length ){ length = ( length == 'l' ) ? 'L' : 'H'; *p++ = *format++; }
+        }else if( *format == 'L' || *format == 'z' || *format == 'j' || *format == 't' ){
+            length = *format;
+            *p++ = *format++;
+        }
+        char conversion = *format;
+        if( conversion == '\0' ){ break; }
+        format++;
+        *p++ = conversion;
+        *p = '\0';
+
+        char text[64];
+        int n = 0;
+        switch( conversion ){
+            case '%':
+                out.write("%", 1);
+                continue;
+
+            case 's': {
+                // Strings can be long, copy them straight to the stream
+                const char* s = va_arg(args, const char*);
+                if( s == NULL ){ s = "(null)"; }
+                size_t size = ( precision >= 0 ) ? strnlen(s, precision) : strlen(s);
+                int padding = width > (int)size ? width - size : 0;
+                if( !left ){ out.pad(' ', padding); }
+                out.write(s, size);
+                if( left ){ out.pad(' ', padding); }
+                continue;
+            }
+
+            case 'n':
+                *va_arg(args, int*) = out.total;
+                continue;
+
+            case 'c':
+                n = snprintf(text, sizeof(text), spec, va_arg(args, int));
+                break;
+
+            case 'p':
+                n = snprintf(text, sizeof(text), spec, va_arg(args, void*));
+                break;
+
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                if( length == 'L' ){
+                    n = snprintf(text, sizeof(text), spec, va_arg(args, long double));
+                }else{
+                    n = snprintf(text, sizeof(text), spec, va_arg(args, double));
+                }
+                break;
+
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+                // Pass the argument with the size the specification says, signedness does not matter to va_arg
+                switch( length ){
+                    case 'L': n = snprintf(text, sizeof(text), spec, va_arg(args, long long)); break;
+                    case 'l': n = snprintf(text, sizeof(text), spec, va_arg(args, long));      break;
+                    case 'z': n = snprintf(text, sizeof(text), spec, va_arg(args, size_t));    break;
+                    case 'j': n = snprintf(text, sizeof(text), spec, va_arg(args, intmax_t));  break;
+                    case 't': n = snprintf(text, sizeof(text), spec, va_arg(args, ptrdiff_t)); break;
+                    default:  n = snprintf(text, sizeof(text), spec, va_arg(args, int));       break;
+                }
+                break;
+
+            default:
+                // Not a conversion we know, print it as it is like newlib does
+                out.write(spec, p - spec);
+                continue;
+        }
+
+        if( n > (int)sizeof(text) - 1 ){ n = sizeof(text) - 1; }
+        if( n > 0 ){ out.write(text, n); }
+    }
+
+    out.flush();
+    return out.total;
+}
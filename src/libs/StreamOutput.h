@@ -17,34 +17,26 @@
 // They are usually associated with a command source, but can also be a NullStreamOutput if we just want to ignore whatever is sent
 
 class NullStreamOutput;
+class FrameDecoder;
+
+// printf formats into a buffer on the stack without touching the heap, and hands it to puts() in one piece when the message fits,
+// which all the usual replies do, longer ones go to puts() a few whole lines at a time
+#define STREAM_PRINTF_BUFFER_SIZE   192
 
 class StreamOutput {
     public:
         StreamOutput(){}
         virtual ~StreamOutput(){}
 
-        virtual int printf(const char* format, ...) __attribute__ ((format(printf, 2, 3))) {
-            char *buffer;
-            // Make the message
-            va_list args;
-            va_start(args, format);
-
-            int size = vsnprintf(NULL, 0, format, args)
-                + 1; // we add one to take into account space for the terminating \0
-
-            buffer = new char[size];
-            vsnprintf(buffer, size, format, args);
-            va_end(args);
-
-            puts(buffer);
-
-            delete[] buffer;
-            return size - 1;
-        }
+        virtual int printf(const char* format, ...) __attribute__ ((format(printf, 2, 3)));
+        int vprintf(const char* format, va_list args);
         virtual int _putc(int c) { return 1; }
         virtual int _getc(void) { return 0; }
         virtual int puts(const char* str) = 0;
 
+        // Streams that can receive framed gcode ( see FrameDecoder ) return their decoder
+        virtual FrameDecoder* get_frame_decoder() { return NULL; }
+
         static NullStreamOutput NullStream;
 };
 
@@ -16,15 +16,10 @@ using namespace std;
 
 #include "libs/StreamOutput.h"
 
-#define PRINTF_DEFAULT_BUFFER_SIZE 32
-
+// Broadcasting : printf is StreamOutput's, so a message is formatted once and each piece goes to every stream through puts()
 class StreamOutputPool : public StreamOutput {
-private:
-    char *printf_default_buffer;
 public:
-    StreamOutputPool(){
-        printf_default_buffer = new char[PRINTF_DEFAULT_BUFFER_SIZE];
-    }
+    StreamOutputPool(){}
 
     int puts(const char* s)
     {
@@ -0,0 +1,132 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TaskScheduler.h"
+#include "libs/StreamOutput.h"
+#include "us_ticker_api.h"
+#include <algorithm>
+#include <stdio.h>
+
+static bool higher_priority(const Task& a, const Task& b){
+    return a.priority < b.priority;
+}
+
+TaskScheduler::TaskScheduler(){
+    this->depth = 0;
+    this->nested_us = 0;
+}
+
+// A module registered for ON_MAIN_LOOP or ON_IDLE, it gets a task with default settings
+void TaskScheduler::add(_EVENT_ENUM event, Module* module){
+    this->configure(event, module, NULL, TASK_PRIORITY_NORMAL, 0, 0);
+}
+
+// Set up the module's task for this event, adding it if the module did not register for the event yet
+void TaskScheduler::configure(_EVENT_ENUM event, Module* module, const char* name, uint8_t priority, uint32_t period_us, uint32_t budget_us){
+    vector<Task>& tasks = this->tasks_for(event);
+    Task* task = NULL;
+    for( unsigned int i = 0; i < tasks.size(); i++ ){
+        if( tasks[i].module == module ){ task = &tasks[i]; break; }
+    }
+    if( task == NULL ){
+        tasks.push_back(Task());
+        task = &tasks.back();
+        task->module   = module;
+        task->last_run = us_ticker_read();
+    }else if( name == NULL ){
+        // Registering again does not undo what the module configured
+        return;
+    }
+
+    task->name      = name;
+    task->priority  = priority;
+    task->period_us = period_us;
+    task->budget_us = budget_us;
+    task->runs      = 0;
+    task->overruns  = 0;
+    task->max_us    = 0;
+    task->total_us  = 0;
+    this->sort(tasks);
+}
+
+// Tasks of the same priority keep the order they registered in, as with the plain event call
+void TaskScheduler::sort(vector<Task>& tasks){
+    std::stable_sort(tasks.begin(), tasks.end(), higher_priority);
+}
+
+// One pass : run every task that is due, highest priority first
+// Handlers may wait on ON_IDLE themselves ( see Kernel::idle_wait ), so this is reentered : tasks are always accessed by index, never kept by reference across a call
+void TaskScheduler::run(_EVENT_ENUM event, void* argument){
+    vector<Task>& tasks = this->tasks_for(event);
+    ModuleCallback callback = kernel_callback_functions[event];
+    uint32_t pass_start = us_ticker_read();
+    uint32_t nested_start = this->nested_us;
+    this->depth++;
+
+    for( unsigned int i = 0; i < tasks.size(); i++ ){
+        uint32_t now   = us_ticker_read();
+        uint32_t since = now - tasks[i].last_run;
+        if( tasks[i].period_us != 0 && since < tasks[i].period_us ){ continue; }
+        if( tasks[i].priority >= TASK_PRIORITY_UI && now - pass_start >= TASK_PASS_BUDGET_US && since < TASK_MAX_DEFER_US ){ continue; }
+
+        tasks[i].last_run = now;
+        uint32_t nested_before = this->nested_us;
+        (tasks[i].module->*callback)(argument);
+        uint32_t took = us_ticker_read() - now;
+
+        // Passes run while the task waited are not its own time
+        uint32_t nested = this->nested_us - nested_before;
+        took = took > nested ? took - nested : 0;
+
+        Task& task = tasks[i];
+        task.runs++;
+        task.total_us += took;
+        if( took > task.max_us ){ task.max_us = took; }
+        if( task.budget_us != 0 && took > task.budget_us ){ task.overruns++; }
+    }
+
+    // A nested pass counts once, with the passes nested in it, for the task that is waiting on it
+    this->depth--;
+    if( this->depth > 0 ){
+        this->nested_us = nested_start + ( us_ticker_read() - pass_start );
+    }
+}
+
+// Print how long each task takes, for the "tasks" console command
+void TaskScheduler::report(StreamOutput* stream){
+    static const char* priorities[] = { "motion", "comms", "normal", "ui" };
+    stream->printf("event     task         priority  period_us  budget_us  runs       avg_us  max_us  overruns\r\n");
+    for( int e = 0; e < 2; e++ ){
+        for( unsigned int i = 0; i < this->tasks[e].size(); i++ ){
+            Task& task = this->tasks[e][i];
+            char name[13];
+            if( task.name != NULL ){
+                snprintf(name, sizeof(name), "%s", task.name);
+            }else{
+                snprintf(name, sizeof(name), "%p", task.module);
+            }
+            unsigned long average = task.runs == 0 ? 0 : (unsigned long)(task.total_us / task.runs);
+            stream->printf("%-9s %-12s %-9s %-10lu %-10lu %-10lu %-7lu %-7lu %lu\r\n",
+                           e == 0 ? "main_loop" : "idle", name, priorities[task.priority > TASK_PRIORITY_UI ? TASK_PRIORITY_UI : task.priority],
+                           (unsigned long)task.period_us, (unsigned long)task.budget_us, (unsigned long)task.runs,
+                           average, (unsigned long)task.max_us, (unsigned long)task.overruns);
+        }
+    }
+    stream->printf("times leave out the tasks run while a task waits, but not the time it sleeps waiting\r\n");
+}
+
+void TaskScheduler::reset_stats(){
+    for( int e = 0; e < 2; e++ ){
+        for( unsigned int i = 0; i < this->tasks[e].size(); i++ ){
+            Task& task = this->tasks[e][i];
+            task.runs     = 0;
+            task.overruns = 0;
+            task.max_us   = 0;
+            task.total_us = 0;
+        }
+    }
+}
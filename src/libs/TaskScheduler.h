@@ -0,0 +1,63 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include "libs/Module.h"
+#include <stdint.h>
+#include <vector>
+using std::vector;
+
+class StreamOutput;
+
+// ON_MAIN_LOOP and ON_IDLE handlers are run as tasks : each has a priority, and may have a minimum period and a time budget
+// A module registers for the event as usual, which gives it a task with default settings, and can then tune it with Kernel::set_task
+// Tasks run in priority order each pass. UI tasks are put off to the next pass once the pass has run long, so they can't starve the planner
+
+#define TASK_PRIORITY_MOTION    0   // Feeds the planner, or frees its queue
+#define TASK_PRIORITY_COMMS     1   // Reads commands from the host
+#define TASK_PRIORITY_NORMAL    2   // Default
+#define TASK_PRIORITY_UI        3   // Panel, logging, can be put off
+
+#define TASK_PASS_BUDGET_US     1000    // Once a pass has taken this long, UI tasks wait for the next one
+#define TASK_MAX_DEFER_US       100000  // ... but they are never put off longer than this
+
+struct Task {
+    Module*     module;
+    const char* name;           // For the tasks report, NULL if the module did not name it
+    uint8_t     priority;
+    uint32_t    period_us;      // Run at most this often, 0 for every pass
+    uint32_t    budget_us;      // How long a run should take at most, 0 for no limit. Longer runs are counted as overruns
+    uint32_t    last_run;       // us_ticker time the task last ran
+
+    uint32_t    runs;
+    uint32_t    overruns;
+    uint32_t    max_us;
+    uint64_t    total_us;
+};
+
+class TaskScheduler {
+    public:
+        TaskScheduler();
+        static bool schedules(_EVENT_ENUM event){ return event == ON_MAIN_LOOP || event == ON_IDLE; }
+        void add(_EVENT_ENUM event, Module* module);
+        void configure(_EVENT_ENUM event, Module* module, const char* name, uint8_t priority, uint32_t period_us, uint32_t budget_us);
+        void run(_EVENT_ENUM event, void* argument);
+        void report(StreamOutput* stream);
+        void reset_stats();
+
+    private:
+        vector<Task>& tasks_for(_EVENT_ENUM event){ return this->tasks[event == ON_IDLE ? 1 : 0]; }
+        void sort(vector<Task>& tasks);
+
+        vector<Task> tasks[2];     // ON_MAIN_LOOP and ON_IDLE tasks, in priority order
+        uint8_t      depth;        // How many passes are running, more than one when a task waits on ON_IDLE
+        uint32_t     nested_us;    // Time taken by nested passes, so the task that waited is not charged for the tasks run meanwhile
+};
+
+#endif
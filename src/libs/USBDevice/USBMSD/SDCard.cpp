@@ -64,10 +64,12 @@
  * just always use the Standard Capacity cards with a block size of 512 bytes.
  * This is set with CMD16.
  *
- * You can read and write single blocks (CMD17, CMD25) or multiple blocks
- * (CMD18, CMD25). For simplicity, I'll just use single block accesses. When
- * the card gets a read command, it responds with a response token, and then
- * a data token or an error.
+ * You can read and write single blocks (CMD17, CMD24) or multiple blocks
+ * (CMD18, CMD25). Single blocks are used when FatFs or USB MSD want one
+ * sector, multiple blocks when they want a run of consecutive sectors, which
+ * saves a command and a card access time per sector. When the card gets a
+ * read command, it responds with a response token, and then a data token or
+ * an error.
  *
  * SPI Command Format
  * ------------------
@@ -115,16 +117,30 @@
  * +------+---------+---------+- -  - -+---------+-----------+----------+
  * | 0xFE | data[0] | data[1] |        | data[n] | crc[15:8] | crc[7:0] |
  * +------+---------+---------+- -  - -+---------+-----------+----------+
+ *
+ * Multiple Block Read and Write
+ * -----------------------------
+ *
+ * After CMD18 the card sends data blocks as above one after the other until
+ * it gets STOP_TRANSMISSION (CMD12), which is answered after a stuff byte by
+ * an R1b response.
+ *
+ * After CMD25 each block is sent with a 0xFC start token instead of 0xFE, and
+ * gets a data response token and busy signal as for single blocks. The
+ * transfer is ended with a 0xFD stop token, followed by a busy signal.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "SDCard.h"
+#include "us_ticker_api.h"
 
 static const uint8_t OXFF = 0xFF;
 
 #define SD_COMMAND_TIMEOUT 5000
+#define SD_READ_TIMEOUT_US   100000 // a card has 100ms to start sending a data block
+#define SD_WRITE_TIMEOUT_US  500000 // ... and 500ms to program one
 
 SDCard::SDCard(PinName mosi, PinName miso, PinName sclk, PinName cs) :
   _spi(mosi, miso, sclk), _cs(cs) {
@@ -285,46 +301,138 @@ int SDCard::disk_initialize()
 
 int SDCard::disk_write(const char *buffer, uint32_t block_number)
 {
+    // the other context ( main loop or USB ) is using the card, nothing was done
     if (busyflag)
-        return 0;
+        return 1;
 
     busyflag = true;
 
-    if (cardtype == SDCARD_FAIL)
+    if (cardtype == SDCARD_FAIL) {
+        busyflag = false;
         return -1;
+    }
     // set write address for single block (CMD24)
     if(_cmd(SDCMD_WRITE_BLOCK, BLOCK2ADDR(block_number)) != 0) {
+        busyflag = false;
         return 1;
     }
 
     // send the data block
-    _write(buffer, 512);
+    int res = _write(buffer, 512);
 
     busyflag = false;
 
-    return 0;
+    return res;
 }
 
 int SDCard::disk_read(char *buffer, uint32_t block_number)
 {
     if (busyflag)
-        return 0;
+        return 1;
 
     busyflag = true;
 
-    if (cardtype == SDCARD_FAIL)
+    if (cardtype == SDCARD_FAIL) {
+        busyflag = false;
         return -1;
+    }
     // set read address for single block (CMD17)
     if(_cmd(SDCMD_READ_SINGLE_BLOCK, BLOCK2ADDR(block_number)) != 0) {
+        busyflag = false;
         return 1;
     }
 
     // receive the data
-    _read(buffer, 512);
+    int res = _read(buffer, 512);
 
     busyflag = false;
 
-    return 0;
+    return res;
+}
+
+int SDCard::disk_write_blocks(const char *buffer, uint32_t block_number, uint32_t count)
+{
+    if (count == 1)
+        return disk_write(buffer, block_number);
+
+    if (busyflag)
+        return 1;
+
+    busyflag = true;
+
+    if (cardtype == SDCARD_FAIL) {
+        busyflag = false;
+        return -1;
+    }
+    // set write address for multiple blocks (CMD25), cs stays low for the whole transfer
+    if(_cmdx(SDCMD_WRITE_MULTIPLE_BLOCK, BLOCK2ADDR(block_number)) != 0) {
+        _cs = 1;
+        _spi.write(0xFF);
+        busyflag = false;
+        return 1;
+    }
+
+    int res = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (_write_block(0xFC, buffer, 512) != 0) {
+            res = 1;
+            break;
+        }
+        buffer += 512;
+    }
+
+    // stop token, then the card is busy while it programs the last block
+    _spi.write(0xFD);
+    _spi.write(0xFF);
+    if (_wait_not_busy() != 0)
+        res = 1;
+
+    _cs = 1;
+    _spi.write(0xFF);
+
+    busyflag = false;
+
+    return res;
+}
+
+int SDCard::disk_read_blocks(char *buffer, uint32_t block_number, uint32_t count)
+{
+    if (count == 1)
+        return disk_read(buffer, block_number);
+
+    if (busyflag)
+        return 1;
+
+    busyflag = true;
+
+    if (cardtype == SDCARD_FAIL) {
+        busyflag = false;
+        return -1;
+    }
+    // set read address for multiple blocks (CMD18), cs stays low for the whole transfer
+    if(_cmdx(SDCMD_READ_MULTIPLE_BLOCK, BLOCK2ADDR(block_number)) != 0) {
+        _cs = 1;
+        _spi.write(0xFF);
+        busyflag = false;
+        return 1;
+    }
+
+    int res = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (_read_block(buffer, 512) != 0) {
+            res = 1;
+            break;
+        }
+        buffer += 512;
+    }
+
+    // the card keeps sending blocks until told to stop
+    if (_stop_transmission() != 0)
+        res = 1;
+
+    busyflag = false;
+
+    return res;
 }
 
 int SDCard::disk_status() { return (_sectors > 0)?0:1; }
@@ -335,7 +443,7 @@ int SDCard::disk_sync() {
 uint32_t SDCard::disk_sectors() { return _sectors; }
 uint64_t SDCard::disk_size() { return ((uint64_t) _sectors) << 9; }
 uint32_t SDCard::disk_blocksize() { return (1<<9); }
-bool SDCard::disk_canDMA() { return false; }
+bool SDCard::disk_canDMA() { return _spi.can_DMA(); }
 
 SDCard::CARD_TYPE SDCard::card_type()
 {
@@ -455,8 +563,12 @@ int SDCard::_cmd8() {
 int SDCard::_read(char *buffer, int length) {
     _cs = 0;
 
-    // read until start byte (0xFF)
-    while(_spi.write(0xFF) != 0xFE);
+    // read until start byte (0xFE), anything else than 0xFF before it is an error token
+    if (_wait_start_token() != 0xFE) {
+        _cs = 1;
+        _spi.write(0xFF);
+        return 1;
+    }
 //     uint8_t r;
 //     while((r = _spi.write(0xFF)) != 0xFE)
 //     {
@@ -467,9 +579,7 @@ int SDCard::_read(char *buffer, int length) {
 //     iprintf("Got start byte, reading data\n");
 
     // read data
-    for(int i=0; i<length; i++) {
-        buffer[i] = _spi.write(0xFF);
-    }
+    _spi.transfer(NULL, (uint8_t *) buffer, length);
     _spi.write(0xFF); // checksum
     _spi.write(0xFF);
 
@@ -485,9 +595,7 @@ int SDCard::_write(const char *buffer, int length) {
     _spi.write(0xFE);
 
     // write the data
-    for(int i=0; i<length; i++) {
-        _spi.write(buffer[i]);
-    }
+    _spi.transfer((const uint8_t *) buffer, NULL, length);
 
     // write the checksum
     _spi.write(0xFF);
@@ -501,10 +609,88 @@ int SDCard::_write(const char *buffer, int length) {
     }
 
     // wait for write to finish
-    while(_spi.write(0xFF) == 0);
+    int res = _wait_not_busy();
+
+    _cs = 1;
+    _spi.write(0xFF);
+    return res;
+}
+
+// Receive one data block of a multiple block read, cs is already low and stays low
+int SDCard::_read_block(char *buffer, int length) {
+    // wait for the start token, anything else than 0xFF or 0xFE is an error token
+    if (_wait_start_token() != 0xFE)
+        return 1;
+
+    _spi.transfer(NULL, (uint8_t *) buffer, length);
+    _spi.write(0xFF); // checksum
+    _spi.write(0xFF);
+    return 0;
+}
+
+// Send one data block of a multiple block write, cs is already low and stays low
+int SDCard::_write_block(char token, const char *buffer, int length) {
+    _spi.write(0xFF);
+    _spi.write(token);
+
+    _spi.transfer((const uint8_t *) buffer, NULL, length);
+
+    // write the checksum
+    _spi.write(0xFF);
+    _spi.write(0xFF);
+
+    // check the repsonse token
+    if((_spi.write(0xFF) & 0x1F) != 0x05)
+        return 1;
+
+    return _wait_not_busy();
+}
+
+// End a multiple block read (CMD12) and release the card
+int SDCard::_stop_transmission() {
+    _spi.write(0x40 | SDCMD_STOP_TRANSMISSION);
+    _spi.write(0x00);
+    _spi.write(0x00);
+    _spi.write(0x00);
+    _spi.write(0x00);
+    _spi.write(0x95);
+
+    // stuff byte, then wait for the R1 response
+    _spi.write(0xFF);
+    int response = -1;
+    for(int i=0; i<SD_COMMAND_TIMEOUT; i++) {
+        response = _spi.write(0xFF);
+        if(!(response & 0x80))
+            break;
+    }
+
+    // R1b : busy until the card is ready again
+    if (_wait_not_busy() != 0)
+        response = -1;
 
     _cs = 1;
     _spi.write(0xFF);
+    return (response & 0x80) ? -1 : response;
+}
+
+// The card sends 0xFF until the start token of a data block, or an error token. Returns 0xFF if it never comes
+int SDCard::_wait_start_token() {
+    uint32_t start = us_ticker_read();
+    int token;
+    while((token = _spi.write(0xFF)) == 0xFF) {
+        if (us_ticker_read() - start > SD_READ_TIMEOUT_US)
+            break;
+    }
+    return token;
+}
+
+// The card holds MISO low while it is busy. Returns 1 if it is still busy after the longest a write may take
+int SDCard::_wait_not_busy() {
+    uint32_t start = us_ticker_read();
+    while(_spi.write(0xFF) == 0) {
+        if (us_ticker_read() - start > SD_WRITE_TIMEOUT_US)
+            return 1;
+    }
     return 0;
 }
 
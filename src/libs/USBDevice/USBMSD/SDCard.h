@@ -70,6 +70,8 @@ public:
     virtual int disk_initialize();
     virtual int disk_write(const char *buffer, uint32_t block_number);
     virtual int disk_read(char *buffer, uint32_t block_number);
+    virtual int disk_write_blocks(const char *buffer, uint32_t block_number, uint32_t count);
+    virtual int disk_read_blocks(char *buffer, uint32_t block_number, uint32_t count);
     virtual int disk_status();
     virtual int disk_sync();
     virtual uint32_t disk_sectors();
@@ -95,6 +97,11 @@ protected:
 
     int _read(char *buffer, int length);
     int _write(const char *buffer, int length);
+    int _read_block(char *buffer, int length);
+    int _write_block(char token, const char *buffer, int length);
+    int _stop_transmission();
+    int _wait_start_token();
+    int _wait_not_busy();
 
     uint32_t _sd_sectors();
     uint32_t _sectors;
@@ -185,9 +185,16 @@ bool USBMSD::connect()
     BlockSize = disk->disk_blocksize();
 
     if ((BlockCount > 0) && (BlockSize != 0)) {
-        page = (uint8_t *) ahbmalloc(BlockSize, AHB_BANK_0);
+        // room for several blocks so long reads can use multiple block transfers, or just one if memory is short
+        page_capacity = MSD_PAGE_BLOCKS;
+        page = (uint8_t *) ahbmalloc(BlockSize * MSD_PAGE_BLOCKS, AHB_BANK_0);
+        if (page == NULL) {
+            page_capacity = 1;
+            page = (uint8_t *) ahbmalloc(BlockSize, AHB_BANK_0);
+        }
         if (page == NULL)
             return false;
+        page_blocks = page_block = 0;
     } else {
         return false;
     }
@@ -626,17 +633,24 @@ void USBMSD::memoryRead (void) {
         stage = ERROR;
     }
 
-    // we read an entire block
-    if (addr_in_block == 0)
+    // we read as many of the remaining blocks as fit in the page
+    if (addr_in_block == 0 && page_block >= page_blocks)
     {
-        iprintf("MSD:LBA %lu:", lba);
-        disk->disk_read((char *)page, lba);
+        uint32_t count = (length + BlockSize - 1) / BlockSize;
+        if (count > page_capacity)
+            count = page_capacity;
+        if (count < 1)
+            count = 1;
+        iprintf("MSD:LBA %lu+%lu:", lba, count);
+        disk->disk_read_blocks((char *)page, lba, count);
+        page_blocks = count;
+        page_block = 0;
     }
 
     iprintf(" %u", addr_in_block / MAX_PACKET_SIZE_EPBULK);
 
     // write data which are in RAM
-    usb->writeNB(MSC_BulkIn.bEndpointAddress, &page[addr_in_block], n, MAX_PACKET_SIZE_EPBULK);
+    usb->writeNB(MSC_BulkIn.bEndpointAddress, &page[page_block * BlockSize + addr_in_block], n, MAX_PACKET_SIZE_EPBULK);
 
     addr_in_block += n;
 
@@ -647,6 +661,7 @@ void USBMSD::memoryRead (void) {
     {
         iprintf("\n");
         addr_in_block = 0;
+        page_block++;
         lba++;
     }
 
@@ -705,6 +720,7 @@ bool USBMSD::infoTransfer (void) {
     }
 
     addr_in_block = 0;
+    page_blocks = page_block = 0;
 
 //     iprintf("MSD:transferring %lu blocks from LBA %lu.\n", blocks, lba);
 
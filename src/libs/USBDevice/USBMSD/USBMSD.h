@@ -33,6 +33,9 @@
 
 #include "Module.h"
 
+// Blocks read from the disk at once when the host reads consecutive blocks
+#define MSD_PAGE_BLOCKS 4
+
 /**
  * USBMSD class: generic class in order to use all kinds of blocks storage chip
  *
@@ -159,7 +162,11 @@ private:
     bool memOK;
 
     // cache in RAM before writing in memory. Useful also to read a block.
+    // Reads fill it with up to page_capacity consecutive blocks at once
     uint8_t * page;
+    uint8_t page_capacity;
+    uint8_t page_blocks;
+    uint8_t page_block;
 
     // USB packet buffer
     uint8_t buffer[MAX_PACKET_SIZE_EPBULK];
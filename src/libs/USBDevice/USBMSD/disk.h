@@ -23,6 +23,42 @@ public:
      */
     virtual int disk_write(const char * data, uint32_t block) { return 0; };
 
+    /*
+     * read consecutive blocks, disks that can do it in one transfer override this
+     *
+     * @param data pointer where will be stored read data
+     * @param block first block number
+     * @param count number of blocks
+     * @returns 0 if successful
+     */
+    virtual int disk_read_blocks(char * data, uint32_t block, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            int res = disk_read(data, block + i);
+            if (res)
+                return res;
+            data += disk_blocksize();
+        }
+        return 0;
+    };
+
+    /*
+     * write consecutive blocks, disks that can do it in one transfer override this
+     *
+     * @param data data to write
+     * @param block first block number
+     * @param count number of blocks
+     * @returns 0 if successful
+     */
+    virtual int disk_write_blocks(const char * data, uint32_t block, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            int res = disk_write(data, block + i);
+            if (res)
+                return res;
+            data += disk_blocksize();
+        }
+        return 0;
+    };
+
     /*
      * Disk initilization
      */
@@ -23,33 +23,87 @@
 
 #include "libs/Kernel.h"
 #include "libs/SerialMessage.h"
+#include "us_ticker_api.h"
 
 // extern void setled(int, bool);
 #define setled(a, b) do {} while (0)
 
 #define iprintf(...) do { } while (0)
 
-USBSerial::USBSerial(USB *u): USBCDC(u), rxbuf(128 + 8), txbuf(128 + 8)
+USBSerial::USBSerial(USB *u): USBCDC(u), rxbuf(USBSERIAL_RX_BUFFER_SIZE), txbuf(USBSERIAL_TX_BUFFER_SIZE)
 {
     usb = u;
     nl_in_rx = 0;
     attach = attached = false;
+    tx_stalled = false;
+    line.stream = this;
+    line.message.reserve(SERIAL_MESSAGE_RESERVE);
+    framing.rx_limit = USBSERIAL_RX_BUFFER_SIZE - 1;
 }
 
-void USBSerial::ensure_tx_space(int space)
+uint32_t USBSerial::tx_dropped = 0;
+uint32_t USBSerial::tx_dropped_messages = 0;
+
+// Whether a message holds an ok, the host counts those to know how many more lines it may send
+static bool has_ack(const char *str)
 {
+    return strncmp(str, "ok", 2) == 0 || strstr(str, "\nok") != NULL;
+}
+
+// Wait for the host to make room in the ring, returns false if the bytes have to be dropped
+// We wait as long as the host keeps reading, but a port that is open and not read ( a terminal left in the background ) would otherwise stall the main loop, and motion with it, forever
+// Once it stopped reading we drop output until it drains half the ring, except acks which still wait for it
+bool USBSerial::ensure_tx_space(int space, bool ack)
+{
+    if (!tx_stalled && txbuf.free() >= space)
+        return true;
+
+    if (tx_stalled && txbuf.free() >= txbuf.available())
+    {
+        tx_stalled = false;
+        if (txbuf.free() >= space)
+            return true;
+    }
+
+    // An interrupt handler ( or code with interrupts off ) can't wait, the USB interrupt it would wait on may not be able to run
+    // ( VECTACTIVE is the exception being handled )
+    if ((SCB->ICSR & 0x1FF) || __get_PRIMASK())
+        return false;
+
+    if (tx_stalled && !ack)
+        return false;
+
+    uint32_t start = us_ticker_read();
+    uint16_t last_free = txbuf.free();
     while (txbuf.free() < space)
     {
+        if (!attached)
+            return false;
+        if (txbuf.free() != last_free)
+        {
+            // The host is reading, keep waiting
+            last_free = txbuf.free();
+            start = us_ticker_read();
+        }
+        else if (us_ticker_read() - start > USBSERIAL_TX_STALL_US)
+        {
+            tx_stalled = true;
+            return false;
+        }
         usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
-        usb->usbisr();
     }
+    return true;
 }
 
 int USBSerial::_putc(int c)
 {
     if (!attached)
         return 1;
-    ensure_tx_space(1);
+    if (!ensure_tx_space(1, false))
+    {
+        tx_dropped++;
+        return 1;
+    }
     txbuf.queue(c);
 
     usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
@@ -75,22 +129,44 @@ int USBSerial::_getc()
     return c;
 }
 
+// Messages are queued whole or dropped whole, so the host never gets part of a line,
+// and with interrupts off so a message printed from an interrupt can't land in the middle of another
 int USBSerial::puts(const char *str)
 {
+    int length = strlen(str);
     if (!attached)
-        return strlen(str);
-    int i = 0;
-    while (*str)
+        return length;
+
+    // Longer than the ring can ever hold, send it in halves of the ring
+    const int most = USBSERIAL_TX_BUFFER_SIZE / 2;
+    bool ack = has_ack(str);
+    for (int sent = 0; sent < length; )
     {
-        ensure_tx_space(1);
-        txbuf.queue(*str);
-        if ((txbuf.available() % 64) == 0)
-            usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
-        i++;
-        str++;
+        int size = length - sent;
+        if (size > most)
+            size = most;
+
+        if (!ensure_tx_space(size, ack))
+        {
+            tx_dropped += length - sent;
+            tx_dropped_messages++;
+            break;
+        }
+
+        __disable_irq();
+        // Something printed from an interrupt may have taken the room we waited for
+        bool fits = txbuf.free() >= size;
+        if (fits)
+        {
+            for (int i = 0; i < size; i++)
+                txbuf.queue(str[sent + i]);
+        }
+        __enable_irq();
+        if (fits)
+            sent += size;
+        usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
     }
-    usb->endpointSetInterrupt(CDC_BulkIn.bEndpointAddress, true);
-    return i;
+    return length;
 }
 
 uint16_t USBSerial::writeBlock(const uint8_t * buf, uint16_t size)
@@ -103,7 +179,7 @@ uint16_t USBSerial::writeBlock(const uint8_t * buf, uint16_t size)
     }
     if (size > 0)
     {
-        for (uint8_t i = 0; i < size; i++)
+        for (uint16_t i = 0; i < size; i++)
         {
             txbuf.queue(buf[i]);
         }
@@ -208,7 +284,7 @@ bool USBSerial::USBEvent_EPOut(uint8_t bEP, uint8_t bEPStatus)
     return r;
 }
 
-uint8_t USBSerial::available()
+uint16_t USBSerial::available()
 {
     return rxbuf.available();
 }
@@ -216,6 +292,7 @@ uint8_t USBSerial::available()
 void USBSerial::on_module_loaded()
 {
     this->register_for_event(ON_MAIN_LOOP);
+    this->kernel->set_task(ON_MAIN_LOOP, this, "usbserial", TASK_PRIORITY_COMMS);
 }
 
 void USBSerial::on_main_loop(void *argument)
@@ -239,26 +316,48 @@ void USBSerial::on_main_loop(void *argument)
             txbuf.flush();
             rxbuf.flush();
             nl_in_rx = 0;
+            tx_stalled = false;
+            framing.stop();
+        }
+    }
+    // In framed mode, newlines mean nothing: we execute a frame as soon as it is complete
+    if (framing.enabled)
+    {
+        while (available())
+        {
+            int result = framing.feed(_getc());
+            if (result == FRAME_READY)
+            {
+                if (!framing.take_upload())
+                {
+                    line.message.assign(framing.payload);
+                    this->kernel->call_event(ON_CONSOLE_LINE_RECEIVED, &line );
+                }
+                framing.processed(this, available() > 0);
+                return;
+            }
+            else if (result == FRAME_ERROR)
+            {
+                framing.reject(this);
+            }
         }
+        return;
     }
     if (nl_in_rx)
     {
-        string received;
+        line.message.clear();
         while (available())
         {
             char c = _getc();
             if( c == '\n' || c == '\r')
             {
-                struct SerialMessage message;
-                message.message = received;
-                message.stream = this;
-                iprintf("USBSerial Received: %s\n", message.message.c_str());
-                this->kernel->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
+                iprintf("USBSerial Received: %s\n", line.message.c_str());
+                this->kernel->call_event(ON_CONSOLE_LINE_RECEIVED, &line );
                 return;
             }
             else
             {
-                received += c;
+                line.message += c;
             }
         }
     }
@@ -25,6 +25,13 @@
 
 #include "Module.h"
 #include "StreamOutput.h"
+#include "FrameDecoder.h"
+#include "SerialMessage.h"
+
+// Both rings live in AHB RAM ( see CircBuffer ), one byte of each is never used
+#define USBSERIAL_TX_BUFFER_SIZE    1024    // Room for a whole ls or M503 page, sent as full 64 byte packets
+#define USBSERIAL_RX_BUFFER_SIZE    512     // Lets a streaming host keep several lines in flight
+#define USBSERIAL_TX_STALL_US       50000   // How long a write waits for the host to read anything, before we stop waiting for it
 
 class USBSerial_Receiver {
 protected:
@@ -39,13 +46,18 @@ public:
     int _getc();
     int puts(const char *);
 
-    uint8_t available();
+    uint16_t available();
 
     uint16_t writeBlock(const uint8_t * buf, uint16_t size);
 
+    FrameDecoder* get_frame_decoder() { return &framing; }
+
     CircBuffer<uint8_t> rxbuf;
     CircBuffer<uint8_t> txbuf;
 
+    static uint32_t tx_dropped;             // Bytes dropped because the host was not reading, see mem
+    static uint32_t tx_dropped_messages;    // Messages they belonged to
+
     void on_module_loaded(void);
     void on_main_loop(void *);
 
@@ -59,12 +71,17 @@ protected:
     virtual void on_attach(void);
     virtual void on_detach(void);
 
-    void ensure_tx_space(int);
+    bool ensure_tx_space(int space, bool ack);
 
     volatile bool attach;
     bool attached;
 
     volatile int nl_in_rx;
+
+    bool tx_stalled;            // The host stopped reading, output is dropped until it drains the ring
+
+    FrameDecoder framing;
+    struct SerialMessage line;  // The line being received, reused for every line
 private:
     USB *usb;
 //     mbed::FunctionPointer rx;
@@ -4,10 +4,47 @@
 #include "lpc17xx_pinsel.h"
 #include "lpc17xx_ssp.h"
 #include "lpc17xx_gpio.h"
+#include "lpc17xx_gpdma.h"
+
+#include "ahbmalloc.h"
 
 #include <stdio.h>
 
 SPI* SPI::isr_dispatch[N_SPI_INTERRUPT_ROUTINES];
+SSPDMA* SSPDMA::instances[SSPDMA_PORTS];
+
+// GPDMA channel registers, channel 0 has the highest priority
+static LPC_GPDMACH_TypeDef* const dma_channels[] = {
+    LPC_GPDMACH0, LPC_GPDMACH1, LPC_GPDMACH2, LPC_GPDMACH3,
+    LPC_GPDMACH4, LPC_GPDMACH5, LPC_GPDMACH6, LPC_GPDMACH7
+};
+
+// The GPDMA only reaches the two AHB SRAM banks, not the local SRAM the heap and stack are in
+#define AHB_SRAM_START  0x2007C000
+#define AHB_SRAM_END    0x20084000
+
+// The GPDMA receive and transmit channels of one SSP port
+class GPDMAChannels : public SSPDMAChannels {
+public:
+    GPDMAChannels(SPI_REG* ssp, int port);
+
+    bool can_reach(const void* buffer, int length);
+    bool can_wait();
+    void drain();
+    bool setup(const uint8_t* tx, uint8_t* rx, int length);
+    void enable();
+    void disable();
+    bool finished();
+    bool failed();
+
+protected:
+    SPI_REG* ssp;
+    uint8_t* dummy;             // 0xFF to send when there is nothing to send, and somewhere to drop what we don't want, in DMA reachable ram
+    uint8_t rx_channel;
+    uint8_t tx_channel;
+    uint8_t rx_connection;
+    uint8_t tx_connection;
+};
 
 class DMA;
 
@@ -89,6 +126,8 @@ SPI::SPI(PinName mosi, PinName miso, PinName sclk)
         frequency(10000);
         sspr->CR1 |= SSP_CR1_SSP_EN;
     }
+
+    dma = SSPDMA::get((sspr == LPC_SSP0) ? 0 : (sspr == LPC_SSP1) ? 1 : -1);
 }
 
 SPI::~SPI()
@@ -176,6 +215,21 @@ uint8_t SPI::write(uint8_t data)
     return r;
 }
 
+// Send and receive a block of bytes, tx NULL sends 0xFF, rx NULL drops what is received
+// Uses the DMA when it can reach both buffers, and polls otherwise
+// From an interrupt handler (USB mass storage) it always polls, the DMA interrupt may not be able to preempt it
+void SPI::transfer(const uint8_t* tx, uint8_t* rx, int length)
+{
+    if (dma && dma->transfer(tx, rx, length))
+        return;
+
+    for (int i = 0; i < length; i++) {
+        uint8_t r = write(tx ? tx[i] : 0xFF);
+        if (rx)
+            rx[i] = r;
+    }
+}
+
 // TODO: timer feeds DMA feeds 0xFFs to card then we listen for responses using our interrupt
 // allow me to do something like:
 // disk.start_multi_write(int blocks, int blocksize, void *buffer);
@@ -193,7 +247,7 @@ uint8_t SPI::write(uint8_t data)
 
 bool SPI::can_DMA()
 {
-    return (sspr != NULL);
+    return (dma != NULL);
 }
 
 // int SPI::setup_DMA_rx(DMA_REG *dma)
@@ -233,6 +287,127 @@ void SPI::irq()
 {
 }
 
+// One per SSP port, so every driver using a port shares its channels
+SSPDMA* SSPDMA::get(int port)
+{
+    if (port < 0 || port >= SSPDMA_PORTS)
+        return NULL;
+
+    if (instances[port] == NULL)
+        instances[port] = new SSPDMA(new GPDMAChannels((port == 0) ? LPC_SSP0 : LPC_SSP1, port));
+    return instances[port];
+}
+
+GPDMAChannels::GPDMAChannels(SPI_REG* ssp, int port)
+{
+    static bool gpdma_ready = false;
+    if (!gpdma_ready) {
+        GPDMA_Init();
+        NVIC_EnableIRQ(DMA_IRQn);
+        gpdma_ready = true;
+    }
+
+    this->ssp = ssp;
+
+    // Receive gets the higher priority channel, so the receive FIFO is always emptied in time
+    rx_channel = 2 + (2 * port);
+    tx_channel = rx_channel + 1;
+    rx_connection = (port == 0) ? GPDMA_CONN_SSP0_Rx : GPDMA_CONN_SSP1_Rx;
+    tx_connection = (port == 0) ? GPDMA_CONN_SSP0_Tx : GPDMA_CONN_SSP1_Tx;
+
+    dummy = (uint8_t*) ahbmalloc(2, AHB_BANK_0);
+    if (dummy)
+        dummy[0] = 0xFF;
+}
+
+bool GPDMAChannels::can_reach(const void* buffer, int length)
+{
+    uint32_t address = (uint32_t) buffer;
+    return (address >= AHB_SRAM_START) && (address + length <= AHB_SRAM_END);
+}
+
+bool GPDMAChannels::can_wait()
+{
+    return (SCB->ICSR & 0x1FF) == 0;     // VECTACTIVE, the exception being handled
+}
+
+void GPDMAChannels::drain()
+{
+    while (ssp->SR & SSP_SR_BSY);
+    while (ssp->SR & SSP_SR_RNE)
+        (void) ssp->DR;
+}
+
+bool GPDMAChannels::setup(const uint8_t* tx, uint8_t* rx, int length)
+{
+    if (dummy == NULL)
+        return false;
+
+    GPDMA_Channel_CFG_Type config;
+    config.TransferSize = length;
+    config.TransferWidth = 0;
+    config.DMALLI = 0;
+
+    config.ChannelNum = rx_channel;
+    config.TransferType = GPDMA_TRANSFERTYPE_P2M;
+    config.SrcConn = rx_connection;
+    config.DstConn = rx_connection;
+    config.SrcMemAddr = 0;
+    config.DstMemAddr = (uint32_t) (rx ? rx : dummy + 1);
+    if (GPDMA_Setup(&config) == ERROR)
+        return false;
+    if (rx == NULL)
+        dma_channels[rx_channel]->DMACCControl &= ~GPDMA_DMACCxControl_DI;
+
+    config.ChannelNum = tx_channel;
+    config.TransferType = GPDMA_TRANSFERTYPE_M2P;
+    config.SrcConn = tx_connection;
+    config.DstConn = tx_connection;
+    config.SrcMemAddr = (uint32_t) (tx ? tx : dummy);
+    config.DstMemAddr = 0;
+    if (GPDMA_Setup(&config) == ERROR)
+        return false;
+    if (tx == NULL)
+        dma_channels[tx_channel]->DMACCControl &= ~GPDMA_DMACCxControl_SI;
+    // Only the end of the receive matters
+    dma_channels[tx_channel]->DMACCConfig &= ~GPDMA_DMACCxConfig_ITC;
+    return true;
+}
+
+void GPDMAChannels::enable()
+{
+    GPDMA_ChannelCmd(rx_channel, ENABLE);
+    GPDMA_ChannelCmd(tx_channel, ENABLE);
+    ssp->DMACR = SSP_DMA_RXDMA_EN | SSP_DMA_TXDMA_EN;
+}
+
+void GPDMAChannels::disable()
+{
+    uint32_t channels = (1UL << rx_channel) | (1UL << tx_channel);
+    GPDMA_ChannelCmd(rx_channel, DISABLE);
+    GPDMA_ChannelCmd(tx_channel, DISABLE);
+    LPC_GPDMA->DMACIntTCClear = channels;
+    LPC_GPDMA->DMACIntErrClr = channels;
+    ssp->DMACR = 0;
+}
+
+bool GPDMAChannels::finished()
+{
+    return (LPC_GPDMA->DMACIntTCStat & (1UL << rx_channel)) != 0;
+}
+
+bool GPDMAChannels::failed()
+{
+    return (LPC_GPDMA->DMACIntErrStat & ((1UL << rx_channel) | (1UL << tx_channel))) != 0;
+}
+
+extern "C" void DMA_IRQHandler(void) {
+    for (int i = 0; i < SSPDMA_PORTS; i++) {
+        if (SSPDMA::instances[i])
+            SSPDMA::instances[i]->irq();
+    }
+}
+
 void SSP0_IRQHandler(void) {
     if (SPI::isr_dispatch[0])
         SPI::isr_dispatch[0]->irq();
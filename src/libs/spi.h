@@ -2,8 +2,10 @@
 #define _SPI_H
 
 #include <stdint.h>
+#include <stddef.h>
 
 #include "spi_hal.h"
+#include "sspdma.h"
 
 class SPI {
 public:
@@ -12,6 +14,7 @@ public:
 
     void frequency(uint32_t);
     uint8_t write(uint8_t);
+    void transfer(const uint8_t* tx, uint8_t* rx, int length);
 
 //     int writeblock(uint8_t *, int);
 
@@ -29,6 +32,7 @@ protected:
     Pin_t mosi;
     Pin_t sclk;
     SPI_REG *sspr;
+    SSPDMA *dma;
 };
 
 #endif /* _SPI_H */
@@ -0,0 +1,85 @@
+#include "sspdma.h"
+
+#include "LPC17xx.h"
+#include "us_ticker_api.h"
+
+SSPDMA::SSPDMA(SSPDMAChannels* channels)
+{
+    this->channels = channels;
+    active = false;
+    error = false;
+}
+
+// Move length bytes and wait for them, returns false if the DMA could not and the caller should poll instead
+bool SSPDMA::transfer(const uint8_t* tx, uint8_t* rx, int length)
+{
+    if (length < SPI_DMA_MIN_LENGTH || !channels->can_wait() || !start(tx, rx, length))
+        return false;
+    if (wait() && !error)
+        return true;
+
+    // Whatever the failed transfer left behind would be taken for the polled data
+    channels->drain();
+    return false;
+}
+
+// Start moving length bytes, returns false if the DMA can't do this one and the caller should poll instead
+bool SSPDMA::start(const uint8_t* tx, uint8_t* rx, int length)
+{
+    if (active || length < 1 || length > SPI_DMA_MAX_LENGTH)
+        return false;
+    if ((tx && !channels->can_reach(tx, length)) || (rx && !channels->can_reach(rx, length)))
+        return false;
+
+    // Whatever polled transfers left in the receive FIFO would be taken for our data
+    channels->drain();
+    if (!channels->setup(tx, rx, length))
+        return false;
+
+    active = true;
+    error = false;
+    channels->enable();
+    return true;
+}
+
+// Wait for the transfer to finish, the DMA interrupt must be able to run
+// Gives up on a transfer that never finishes, so a stuck DMA can't hang the caller, returns false if it did
+bool SSPDMA::wait()
+{
+    uint32_t start = us_ticker_read();
+    while (active) {
+        if (us_ticker_read() - start > SPI_DMA_TIMEOUT_US) {
+            abort();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Stop the transfer in progress and mark it failed
+void SSPDMA::abort()
+{
+    __disable_irq();
+    if (active) {
+        channels->disable();
+        error = true;
+        active = false;
+    }
+    __enable_irq();
+}
+
+// Called from the DMA interrupt, finishes our transfer if it is done or went wrong
+void SSPDMA::irq()
+{
+    if (!active)
+        return;
+
+    bool failed = channels->failed();
+    if (!failed && !channels->finished())
+        return;
+
+    channels->disable();
+    error = failed;
+    active = false;
+    done_hook.call(failed ? 1 : 0);
+}
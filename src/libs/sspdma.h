@@ -0,0 +1,70 @@
+#ifndef _SSPDMA_H
+#define _SSPDMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "libs/Hook.h"
+
+// Transfers shorter than this are polled, setting up the DMA would take longer
+#define SPI_DMA_MIN_LENGTH  16
+// Most bytes a single GPDMA transfer can move
+#define SPI_DMA_MAX_LENGTH  4095
+// A transfer that takes longer than this is abandoned
+#define SPI_DMA_TIMEOUT_US  100000
+
+#define SSPDMA_PORTS        2
+
+// The receive and transmit DMA channels of one SSP port, and the port itself
+// spi.cpp drives the GPDMA with them, host tests a fake
+class SSPDMAChannels {
+public:
+    virtual ~SSPDMAChannels() {}
+
+    // Whether the DMA can reach this memory
+    virtual bool can_reach(const void* buffer, int length) = 0;
+    // Whether we can wait for the DMA interrupt, not from an interrupt handler it may not be able to preempt
+    virtual bool can_wait() = 0;
+    // Wait for the port to be idle, and drop what is in its receive FIFO
+    virtual void drain() = 0;
+    // Set both channels up for length bytes, tx NULL sends 0xFF, rx NULL drops what is received. Returns false if they can't be
+    virtual bool setup(const uint8_t* tx, uint8_t* rx, int length) = 0;
+    virtual void enable() = 0;
+    // Stop both channels and clear their interrupts
+    virtual void disable() = 0;
+    // Whether the receive channel got the last byte, the transfer is complete then
+    virtual bool finished() = 0;
+    // Whether either channel had an error
+    virtual bool failed() = 0;
+};
+
+// DMA transfers on one of the SSP ports, whichever driver set the port up
+// The transfer is complete once the last byte is received, so the chip select can be released from the completion callback
+class SSPDMA {
+public:
+    SSPDMA(SSPDMAChannels* channels);
+
+    static SSPDMA* get(int port);
+
+    bool transfer(const uint8_t* tx, uint8_t* rx, int length);
+    bool start(const uint8_t* tx, uint8_t* rx, int length);
+    bool wait();
+    void abort();
+    bool busy() { return active; }
+    bool failed() { return error; }
+
+    // Called from the DMA interrupt when a transfer is finished, with 1 if it failed
+    template<class T> void attach_done(T* obj, uint32_t (T::*fn)(uint32_t)) { done_hook.attach(obj, fn); }
+
+    void irq(void);
+
+    static SSPDMA* instances[SSPDMA_PORTS];
+
+protected:
+    SSPDMAChannels* channels;
+    volatile bool active;
+    volatile bool error;
+    Hook done_hook;
+};
+
+#endif /* _SSPDMA_H */
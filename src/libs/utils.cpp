@@ -32,6 +32,17 @@ uint16_t get_checksum(const char* to_check){
    return (sum2 << 8) | sum1;
 }
 
+// Checksum of the first length characters, so a word can be summed in place
+uint16_t get_checksum(const char* to_check, size_t length){
+   uint16_t sum1 = 0;
+   uint16_t sum2 = 0;
+   for( size_t i = 0; i < length; i++ ){
+      sum1 = (sum1 + to_check[i]) % 255;
+      sum2 = (sum2 + sum1) % 255;
+   }
+   return (sum2 << 8) | sum1;
+}
+
 void get_checksums(uint16_t check_sums[], const string key){
     const string k = key+" ";
     check_sums[0] = 0x0000;
@@ -21,6 +21,7 @@ string remove_non_number( string str );
 
 uint16_t get_checksum(const string& to_check);
 uint16_t get_checksum(const char* to_check);
+uint16_t get_checksum(const char* to_check, size_t length);
 
 void get_checksums(uint16_t check_sums[], const string key);
 
@@ -36,6 +36,7 @@
 #include "libs/USBDevice/DFU.h"
 
 #include "libs/SDFAT.h"
+#include "libs/SectorCache.h"
 
 #include "libs/Watchdog.h"
 
@@ -50,14 +51,15 @@
 // USB Stuff
 SDCard sd(P0_9, P0_8, P0_7, P0_6);      // this selects SPI1 as the sdcard as it is on Smoothieboard
 //SDCard sd(P0_18, P0_17, P0_15, P0_16);  // this selects SPI0 as the sdcard
+SectorCache cached_sd(&sd);             // both the filesystem and USB go through this, so it never gets stale
 
 USB u;
 USBSerial usbserial(&u);
-USBMSD msc(&u, &sd);
+USBMSD msc(&u, &cached_sd);
 //USBMSD *msc= NULL;
 DFU dfu(&u);
 
-SDFAT mounter("sd", &sd);
+SDFAT mounter("sd", &cached_sd);
 
 GPIO leds[5] = {
     GPIO(P1_18),
@@ -6,6 +6,7 @@
 */
 
 #include <string>
+#include <ctype.h>
 using std::string;
 #include "libs/Module.h"
 #include "libs/Kernel.h"
@@ -15,58 +16,97 @@ using std::string;
 #include "modules/robot/Conveyor.h"
 #include "libs/SerialMessage.h"
 #include "libs/StreamOutput.h"
-#include "libs/FileStream.h"
+#include "libs/AppendFileStream.h"
+#include "libs/FrameDecoder.h"
+#include "libs/utils.h"
 
 GcodeDispatch::GcodeDispatch() {}
 
+// Letters that start a new command when several are on one line
+static bool is_command_letter(char c)
+{
+    return c == 'G' || c == 'M' || c == 'T';
+}
+
 // Called when the module has just been loaded
 void GcodeDispatch::on_module_loaded()
 {
     return_error_on_unhandled_gcode = this->kernel->config->value( return_error_on_unhandled_gcode_checksum )->by_default(false)->as_bool();
-    this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
+    // No need to register for ON_CONSOLE_LINE_RECEIVED, Kernel::route_console_line hands us gcode lines directly
     currentline = -1;
     uploading = false;
+    this->clear_history();
+}
+
+// Forget the lines we accepted, the host is restarting its numbering
+void GcodeDispatch::clear_history()
+{
+    for (int i = 0; i < GCODE_HISTORY_SIZE; i++) {
+        this->history[i].line = -1;
+        this->history[i].hash = 0;
+    }
+    this->history_next = 0;
+}
+
+// Whether this line number was recently accepted with the same content
+bool GcodeDispatch::is_duplicate(int line, uint32_t hash)
+{
+    if (line < 0)
+        return false;
+    for (int i = 0; i < GCODE_HISTORY_SIZE; i++) {
+        if (this->history[i].line == line && this->history[i].hash == hash)
+            return true;
+    }
+    return false;
 }
 
 // When a command is received, if it is a Gcode, dispatch it as an object via an event
 void GcodeDispatch::on_console_line_received(void *line)
 {
-    SerialMessage new_message = *static_cast<SerialMessage *>(line);
-    string possible_command = new_message.message;
+    // The line is only read : it is cut into commands by position, so a steady stream of gcodes makes no strings on the heap
+    SerialMessage& new_message = *static_cast<SerialMessage *>(line);
+    const char *start = new_message.message.c_str();
+    size_t body_start = 0;
+    size_t body_end = new_message.message.size();
 
-    char first_char = possible_command[0];
+    char first_char = start[0];
     int ln = 0;
     int cs = 0;
+    uint32_t hash = 2166136261u;
+
+    // Lines that came in a frame were already checked, and are acknowledged in batches by the stream
+    FrameDecoder* framing = new_message.stream->get_frame_decoder();
+    bool framed = ( framing != NULL && framing->enabled );
     if ( first_char == 'G' || first_char == 'M' || first_char == 'T' || first_char == 'N' ) {
 
         //Get linenumber
         if ( first_char == 'N' ) {
-            Gcode full_line = Gcode(possible_command, new_message.stream);
-            ln = (int) full_line.get_value('N');
-            int chksum = (int) full_line.get_value('*');
+            // Line number, checksum and body hash are all read in one pass, the body is what is between them
+            char *after;
+            ln = (int) strtol(start + 1, &after, 10);
+            const char *c = after;
+            while ( *c == ' ' ) c++;
+            body_start = c - start;
 
-            //Catch message if it is M110: Set Current Line Number
-            if ( full_line.has_letter('M') ) {
-                if ( ((int) full_line.get_value('M')) == 110 ) {
-                    currentline = ln;
-                    new_message.stream->printf("ok\r\n");
-                    return;
-                }
+            uint8_t sum = 0;
+            for (const char *p = start; p < c; p++)
+                sum ^= *p;
+            for ( ; *c != '\0' && *c != '*'; c++ ) {
+                sum ^= *c;
+                hash = (hash ^ (uint8_t) *c) * 16777619u; // FNV-1a
             }
+            body_end = c - start;
+            if ( *c == '*' )
+                cs = sum - (int) strtol(c + 1, NULL, 10);
 
-            //Strip checksum value from possible_command
-            size_t chkpos = possible_command.find_first_of("*");
-            possible_command = possible_command.substr(0, chkpos);
-            //Calculate checksum
-            if ( chkpos != string::npos ) {
-                for (auto c = possible_command.cbegin(); *c != '*' && c != possible_command.cend(); c++)
-                    cs = cs ^ *c;
-                cs &= 0xff;  // Defensive programming...
-                cs -= chksum;
+            //Catch message if it is M110: Set Current Line Number
+            if ( strncmp(start + body_start, "M110", 4) == 0 && !is_digit(start[body_start + 4]) ) {
+                currentline = ln;
+                this->clear_history();
+                if( !framed )
+                    new_message.stream->printf("ok\r\n");
+                return;
             }
-            //Strip line number value from possible_command
-            size_t lnsize = possible_command.find_first_not_of("N0123456789.,- ");
-            possible_command = possible_command.substr(lnsize);
 
         } else {
             //Assume checks succeeded
@@ -75,68 +115,125 @@ void GcodeDispatch::on_console_line_received(void *line)
         }
 
         //Remove comments
-        size_t comment = possible_command.find_first_of(";(");
-        if( comment != string::npos ) {
-            possible_command = possible_command.substr(0, comment);
+        for( size_t i = body_start; i < body_end; i++ ) {
+            if( start[i] == ';' || start[i] == '(' ) {
+                body_end = i;
+                break;
+            }
         }
 
         //If checksum passes then process message, else request resend
         int nextline = currentline + 1;
+
+        // A line we already executed, sent again because the host missed our ok : acknowledge it, but do not run it twice
+        if( first_char == 'N' && cs == 0x00 && ln != nextline && this->is_duplicate(ln, hash) ) {
+            if( !framed )
+                new_message.stream->printf("ok\r\n");
+            return;
+        }
+
         if( cs == 0x00 && ln == nextline ) {
             if( first_char == 'N' ) {
                 currentline = nextline;
+                this->history[this->history_next].line = ln;
+                this->history[this->history_next].hash = hash;
+                this->history_next = (this->history_next + 1) % GCODE_HISTORY_SIZE;
             }
 
-            while(possible_command.size() > 0) {
-                size_t nextcmd = possible_command.find_first_of("GMT", possible_command.find_first_of("GMT") + 1);
-                string single_command;
-                if(nextcmd == string::npos) {
-                    single_command = possible_command;
-                    possible_command = "";
-                } else {
-                    single_command = possible_command.substr(0, nextcmd);
-                    possible_command = possible_command.substr(nextcmd);
-                }
+            size_t position = body_start;
+            while(position < body_end) {
+                // A command runs up to the G, M or T that follows its own
+                size_t nextcmd = position;
+                while(nextcmd < body_end && !is_command_letter(start[nextcmd])) nextcmd++;
+                nextcmd++;
+                while(nextcmd < body_end && !is_command_letter(start[nextcmd])) nextcmd++;
+                if(nextcmd > body_end) nextcmd = body_end;
+
+                const char *single_command = start + position;
+                size_t single_length = nextcmd - position;
+                position = nextcmd;
 
                 if(!uploading) {
-                    //Prepare gcode for dispatch
-                    Gcode *gcode = new Gcode(single_command, new_message.stream);
-                    gcode->prepare_cached_values();
+                    //Prepare gcode for dispatch, on the stack : modules that keep a gcode make their own copy ( see Block::append_gcode )
+                    Gcode gcode_object(single_command, single_length, new_message.stream);
+                    Gcode *gcode = &gcode_object;
 
                     if(gcode->has_m) {
                         switch (gcode->m) {
-                            case 28: // start upload command
-                                delete gcode;
+                            case 28: { // start upload command, M28 <filename> for lines until M29, M28 B<bytes> C<crc16> <filename> for a binary upload in framed mode
+                                const char *p = single_command + (single_length > 3 ? 3 : single_length);
+                                uint32_t length = 0;
+                                uint16_t crc = 0;
+                                while(*p == ' ') p++;
+                                while(*p == 'B' || *p == 'C') {
+                                    // an option is all digits and followed by a space, so "M28 C3.gcode" is a file name
+                                    char *end;
+                                    unsigned long value = strtoul(p + 1, &end, 10);
+                                    if(end == p + 1 || !isdigit(p[1]) || *end != ' ') break;
+                                    if(*p == 'B') length = value; else crc = value;
+                                    p = end;
+                                    while(*p == ' ') p++;
+                                }
+                                const char *end = single_command + single_length;
+                                string filename = "/sd/" + string(p, p < end ? end - p : 0); // rest of line is filename
 
-                                this->upload_filename = "/sd/" + single_command.substr(4); // rest of line is filename
-                                // open file
-                                upload_fd = fopen(this->upload_filename.c_str(), "w");
-                                if(upload_fd != NULL) {
-                                    this->uploading = true;
-                                    new_message.stream->printf("Writing to file: %s\r\n", this->upload_filename.c_str());
+                                if(length > 0 && !framed) {
+                                    new_message.stream->printf("error: binary upload needs framed mode, see M960\r\n");
+                                    continue;
+                                }
+                                if(!this->upload.open(filename, length, crc)) {
+                                    new_message.stream->printf("open failed, File: %s.\r\n", filename.c_str());
+                                    continue;
+                                }
+                                new_message.stream->printf("Writing to file: %s\r\n", filename.c_str());
+                                if(length > 0) {
+                                    framing->upload = &this->upload;
                                 } else {
-                                    new_message.stream->printf("open failed, File: %s.\r\n", this->upload_filename.c_str());
+                                    this->uploading = true;
                                 }
-                                //printf("Start Uploading file: %s, %p\n", upload_filename.c_str(), upload_fd);
                                 continue;
+                            }
 
                             case 500: // M500 save volatile settings to config-override
                                 // delete the existing file
                                 remove(kernel->config_override_filename());
                                 // replace stream with one that writes to config-override file
-                                gcode->stream = new FileStream(kernel->config_override_filename());
+                                gcode->stream = new AppendFileStream(kernel->config_override_filename());
                                 // dispatch the M500 here so we can free up the stream when done
                                 this->kernel->call_event(ON_GCODE_RECEIVED, gcode );
                                 delete gcode->stream;
-                                delete gcode;
-                                new_message.stream->printf("Settings Stored to %s\r\nok\r\n", kernel->config_override_filename());
+                                new_message.stream->printf("Settings Stored to %s\r\n", kernel->config_override_filename());
+                                if( !framed )
+                                    new_message.stream->printf("ok\r\n");
                                 continue;
 
                             case 501: // M501 deletes config-override so everything defaults to what is in config
                                 remove(kernel->config_override_filename());
-                                new_message.stream->printf("config override file deleted %s, reboot needed\r\nok\r\n", kernel->config_override_filename());
-                                delete gcode;
+                                new_message.stream->printf("config override file deleted %s, reboot needed\r\n", kernel->config_override_filename());
+                                if( !framed )
+                                    new_message.stream->printf("ok\r\n");
+                                continue;
+
+                            case 960: { // M960 S1 W<window> switch this stream to framed mode ( see FrameDecoder ), S0 back to text lines
+                                bool on = gcode->has_letter('S') ? gcode->get_value('S') != 0 : true;
+                                int window = gcode->has_letter('W') ? gcode->get_int('W') : 8;
+                                if( framing == NULL ) {
+                                    new_message.stream->printf("error: this stream does not support framed mode\r\nok\r\n");
+                                } else if( on && !framed ) {
+                                    // Tell the host the window we really use, and how many bytes of frames it may have in flight
+                                    framing->start(window);
+                                    new_message.stream->printf("ok W%d B%d\r\n", framing->window, framing->rx_limit);
+                                } else if( on ) {
+                                    // Already framed, the frame's ack follows
+                                    framing->set_window(window);
+                                    new_message.stream->printf("W%d B%d\r\n", framing->window, framing->rx_limit);
+                                } else if( framed ) {
+                                    framing->stop();
+                                } else {
+                                    new_message.stream->printf("ok\r\n");
+                                }
                                 continue;
+                            }
 
                             case 503: { // M503 display live settings and indicates if there is an override file
                                 FILE *fd = fopen(kernel->config_override_filename(), "r");
@@ -158,7 +255,10 @@ void GcodeDispatch::on_console_line_received(void *line)
                     if(gcode->add_nl)
                         new_message.stream->printf("\r\n");
 
-                    if( return_error_on_unhandled_gcode == true && gcode->accepted_by_module == false)
+                    if( framed ) {
+                        if(!gcode->txt_after_ok.empty())
+                            new_message.stream->printf("%s\r\n", gcode->txt_after_ok.c_str());
+                    } else if( return_error_on_unhandled_gcode == true && gcode->accepted_by_module == false)
                         new_message.stream->printf("ok (command unclaimed)\r\n");
                     else if(!gcode->txt_after_ok.empty()) {
                         new_message.stream->printf("ok %s\r\n", gcode->txt_after_ok.c_str());
@@ -166,46 +266,31 @@ void GcodeDispatch::on_console_line_received(void *line)
                     } else
                         new_message.stream->printf("ok\r\n");
 
-                    delete gcode;
-
                 } else {
                     // we are uploading a file so save it
-                    if(single_command.substr(0, 3) == "M29") {
+                    if(single_length >= 3 && strncmp(single_command, "M29", 3) == 0) {
                         // done uploading, close file
-                        fclose(upload_fd);
-                        upload_fd = NULL;
+                        bool good = this->upload.close();
                         uploading = false;
-                        upload_filename.clear();
-                        new_message.stream->printf("Done saving file.\r\n");
+                        new_message.stream->printf(good ? "Done saving file.\r\n" : "Error:error writing to file.\r\n");
                         continue;
                     }
 
-                    if(upload_fd == NULL) {
+                    if(!this->upload.is_open()) {
                         // error detected writing to file so discard everything until it stops
-                        new_message.stream->printf("ok\r\n");
+                        if( !framed )
+                            new_message.stream->printf("ok\r\n");
                         continue;
                     }
 
-                    single_command.append("\n");
-                    static int cnt = 0;
-                    if(fwrite(single_command.c_str(), 1, single_command.size(), upload_fd) != single_command.size()) {
+                    if(!this->upload.write(single_command, single_length) || !this->upload.write("\n", 1)) {
                         // error writing to file
                         new_message.stream->printf("Error:error writing to file.\r\n");
-                        fclose(upload_fd);
-                        upload_fd = NULL;
+                        this->upload.close();
                         continue;
-
-                    } else {
-                        cnt += single_command.size();
-                        if (cnt > 400) {
-                            // HACK ALERT to get around fwrite corruption close and re open for append
-                            fclose(upload_fd);
-                            upload_fd = fopen(upload_filename.c_str(), "a");
-                            cnt = 0;
-                        }
-                        new_message.stream->printf("ok\r\n");
-                        //printf("uploading file write ok\n");
                     }
+                    if( !framed )
+                        new_message.stream->printf("ok\r\n");
                 }
             }
 
@@ -216,7 +301,8 @@ void GcodeDispatch::on_console_line_received(void *line)
 
         // Ignore comments and blank lines
     } else if ( first_char == ';' || first_char == '(' || first_char == ' ' || first_char == '\n' || first_char == '\r' ) {
-        new_message.stream->printf("ok\r\n");
+        if( !framed )
+            new_message.stream->printf("ok\r\n");
     }
 }
 
@@ -15,8 +15,11 @@ using std::string;
 #include "utils/Gcode.h"
 
 #include "libs/StreamOutput.h"
+#include "libs/FileUpload.h"
 #define return_error_on_unhandled_gcode_checksum    CHECKSUM("return_error_on_unhandled_gcode")
 
+#define GCODE_HISTORY_SIZE 16   // How many accepted line numbers we remember to recognize resends
+
 class GcodeDispatch : public Module {
     public:
         GcodeDispatch();
@@ -25,10 +28,17 @@ class GcodeDispatch : public Module {
         virtual void on_console_line_received(void* line);
         bool return_error_on_unhandled_gcode;
     private:
+        void clear_history();
+        bool is_duplicate(int line, uint32_t hash);
+
         int currentline;
-        bool uploading;
-        string upload_filename;
-        FILE *upload_fd;
+        struct {
+            int line;
+            uint32_t hash;
+        } history[GCODE_HISTORY_SIZE];  // Recently accepted lines
+        uint8_t history_next;
+        bool uploading;         // Lines are going to the upload rather than being executed, until M29
+        FileUpload upload;
 };
 
 #endif
@@ -22,6 +22,10 @@ using std::string;
 SerialConsole::SerialConsole( PinName rx_pin, PinName tx_pin, int baud_rate ){
     this->serial = new mbed::Serial( rx_pin, tx_pin );
     this->serial->baud(baud_rate);
+    this->line.stream = this;
+    this->line.message.reserve(SERIAL_MESSAGE_RESERVE);
+    // There is no flow control, the host must not send more frames than the buffer holds
+    this->framing.rx_limit = this->buffer.capacity();
 }
 
 // Called when the module has just been loaded
@@ -31,6 +35,7 @@ void SerialConsole::on_module_loaded() {
 
     // We only call the command dispatcher in the main loop, nowhere else
     this->register_for_event(ON_MAIN_LOOP);
+    this->kernel->set_task(ON_MAIN_LOOP, this, "serial", TASK_PRIORITY_COMMS);
 
     // Add to the pack of streams kernel can call to, for example for broadcasting
     this->kernel->streams->append_stream(this);
@@ -40,28 +45,44 @@ void SerialConsole::on_module_loaded() {
 void SerialConsole::on_serial_char_received(){
     while(this->serial->readable()){
         char received = this->serial->getc();
-        // convert CR to NL (for host OSs that don't send NL)
-        if( received == '\r' ){ received = '\n'; }
+        // convert CR to NL (for host OSs that don't send NL), frames are binary and must be left alone
+        if( received == '\r' && !this->framing.enabled ){ received = '\n'; }
         this->buffer.push_back(received);
     }
 }
 
 // Actual event calling must happen in the main loop because if it happens in the interrupt we will loose data
 void SerialConsole::on_main_loop(void * argument){
+    // In framed mode, we execute one complete frame per main loop, like we do lines
+    if( this->framing.enabled ){
+        while( this->buffer.size() > 0 ){
+            char c;
+            this->buffer.pop_front(c);
+            int result = this->framing.feed(c);
+            if( result == FRAME_READY ){
+                if( !this->framing.take_upload() ){
+                    this->line.message.assign(this->framing.payload);
+                    this->kernel->call_event(ON_CONSOLE_LINE_RECEIVED, &this->line );
+                }
+                this->framing.processed(this, this->buffer.size() > 0);
+                return;
+            }else if( result == FRAME_ERROR ){
+                this->framing.reject(this);
+            }
+        }
+        return;
+    }
+
     if( this->has_char('\n') ){
-        string received;
-        received.reserve(20);
+        this->line.message.clear();
         while(1){
            char c;
            this->buffer.pop_front(c);
            if( c == '\n' ){
-                struct SerialMessage message;
-                message.message = received;
-                message.stream = this;
-                this->kernel->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
+                this->kernel->call_event(ON_CONSOLE_LINE_RECEIVED, &this->line );
                 return;
             }else{
-                received += c;
+                this->line.message += c;
             }
         }
     }
@@ -16,6 +16,8 @@
 using std::string;
 #include "libs/RingBuffer.h"
 #include "libs/StreamOutput.h"
+#include "libs/FrameDecoder.h"
+#include "libs/SerialMessage.h"
 
 
 #define baud_rate_setting_checksum CHECKSUM("baud_rate")
@@ -32,11 +34,14 @@ class SerialConsole : public Module, public StreamOutput {
         int _putc(int c);
         int _getc(void);
         int puts(const char*);
+        FrameDecoder* get_frame_decoder() { return &this->framing; }
 
         //string receive_buffer;                 // Received chars are stored here until a newline character is received
         //vector<std::string> received_lines;    // Received lines are stored here until they are requested
-        RingBuffer<char,256> buffer;             // Receive buffer
+        RingBuffer<char,512> buffer;             // Receive buffer, holds at least one whole frame in framed mode
         mbed::Serial* serial;
+        FrameDecoder framing;                    // Framed mode, when the host asked for it with M960
+        struct SerialMessage line;               // The line being received, reused for every line
 };
 
 #endif
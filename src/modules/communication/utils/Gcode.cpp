@@ -11,19 +11,29 @@ using std::string;
 #include "Gcode.h"
 #include "libs/StreamOutput.h"
 #include "utils.h"
+#include "libs/Profiler.h"
 
 #include <stdlib.h>
 
 // This is a gcode object. It reprensents a GCode string/command, an caches some important values about that command for the sake of performance.
 // It gets passed around in events, and attached to the queue ( that'll change )
-Gcode::Gcode(const string& command, StreamOutput* stream) : command(command), m(0), g(0), add_nl(false), stream(stream) {
+Gcode::Gcode(const string& command, StreamOutput* stream) : m(0), g(0), add_nl(false), stream(stream) {
+    this->command.assign(command);
+    prepare_cached_values();
+    this->millimeters_of_travel = 0L;
+    this->accepted_by_module=false;
+}
+
+// One command out of a longer line, without making a string of it first
+Gcode::Gcode(const char* command, size_t length, StreamOutput* stream) : m(0), g(0), add_nl(false), stream(stream) {
+    this->command.assign(command, length);
     prepare_cached_values();
     this->millimeters_of_travel = 0L;
     this->accepted_by_module=false;
 }
 
 Gcode::Gcode(const Gcode& to_copy){
-    this->command.assign( to_copy.command );
+    this->command = to_copy.command;
     this->millimeters_of_travel = to_copy.millimeters_of_travel;
     this->has_m                 = to_copy.has_m;
     this->has_g                 = to_copy.has_g;
@@ -32,12 +42,12 @@ Gcode::Gcode(const Gcode& to_copy){
     this->add_nl                = to_copy.add_nl;
     this->stream                = to_copy.stream;
     this->accepted_by_module=false;
-    this->txt_after_ok.assign( to_copy.txt_after_ok );
+    this->txt_after_ok = to_copy.txt_after_ok;
 }
 
 Gcode& Gcode::operator= (const Gcode& to_copy){
     if( this != &to_copy ){
-        this->command.assign( to_copy.command );
+        this->command = to_copy.command;
         this->millimeters_of_travel = to_copy.millimeters_of_travel;
         this->has_m                 = to_copy.has_m;
         this->has_g                 = to_copy.has_g;
@@ -45,7 +55,7 @@ Gcode& Gcode::operator= (const Gcode& to_copy){
         this->g                     = to_copy.g;
         this->add_nl                = to_copy.add_nl;
         this->stream                = to_copy.stream;
-        this->txt_after_ok.assign( to_copy.txt_after_ok );
+        this->txt_after_ok = to_copy.txt_after_ok;
     }
     this->accepted_by_module=false;
     return *this;
@@ -55,7 +65,7 @@ Gcode& Gcode::operator= (const Gcode& to_copy){
 // Whether or not a Gcode has a letter
 bool Gcode::has_letter( char letter ){
     //return ( this->command->find( letter ) != string::npos );
-    for (std::string::const_iterator c = this->command.cbegin(); c != this->command.cend(); c++) {
+    for (const char* c = this->command.c_str(); *c; c++) {
         if( *c == letter ){
             return true;
         }
@@ -106,8 +116,11 @@ int Gcode::get_num_args(){
     return count;
 }
 
+static ProfileZone parse_zone("gcode_parse");
+
 // Cache some of this command's properties, so we don't have to parse the string every time we want to look at them
 void Gcode::prepare_cached_values(){
+    ProfileScope profile(parse_zone);
     if( this->has_letter('G') ){
         this->has_g = true;
         this->g = this->get_int('G');
@@ -11,12 +11,17 @@
 #include <string>
 using std::string;
 #include "libs/StreamOutput.h"
+#include "libs/SmallString.h"
 // Object to represent a Gcode command
 #include <stdlib.h>
 
+#define GCODE_COMMAND_INLINE_SIZE   48  // A full G1 X Y Z E F line fits, longer ones go to the heap
+#define GCODE_TEXT_INLINE_SIZE      48  // Room for a two heater M105 report
+
 class Gcode {
     public:
         Gcode(const string&, StreamOutput*);
+        Gcode(const char* command, size_t length, StreamOutput*);
         Gcode(const Gcode& to_copy); 
         Gcode& operator= (const Gcode& to_copy);
         
@@ -31,7 +36,7 @@ class Gcode {
         void   prepare_cached_values();
         void   mark_as_taken();
 
-        string command;
+        SmallString<GCODE_COMMAND_INLINE_SIZE> command;
         double millimeters_of_travel;
 
         bool has_m;
@@ -42,7 +47,7 @@ class Gcode {
         bool add_nl;
         StreamOutput* stream;
 
-        string txt_after_ok;
+        SmallString<GCODE_TEXT_INLINE_SIZE> txt_after_ok;
         bool accepted_by_module;
 
 };
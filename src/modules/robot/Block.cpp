@@ -28,6 +28,8 @@ Block::Block(){
     this->is_ready = false;
     this->initial_rate = -1;
     this->final_rate = -1;
+    this->first_gcode = NULL;
+    this->last_gcode = NULL;
 }
 
 void Block::debug(Kernel* kernel){
@@ -157,16 +159,32 @@ void Block::forward_pass(Block* previous, Block* next){
 // Gcodes are attached to their respective blocks so that on_gcode_execute can be called with it
 void Block::append_gcode(Gcode* gcode){
    __disable_irq();
-   Gcode new_gcode = *gcode;
-   this->gcodes.push_back(new_gcode);
+   DeferredGcode* deferred = this->conveyor->gcode_pool.take(*gcode);
+   if( this->last_gcode == NULL ){
+       this->first_gcode = deferred;
+   }else{
+       this->last_gcode->next = deferred;
+   }
+   this->last_gcode = deferred;
    __enable_irq();
 }
 
 // The attached gcodes are then poped and the on_gcode_execute event is called with them as a parameter
 void Block::pop_and_execute_gcode(Kernel* &kernel){
-    Block* block = const_cast<Block*>(this);
-    for(unsigned short index=0; index<block->gcodes.size(); index++){
-        kernel->call_event(ON_GCODE_EXECUTE, &(block->gcodes[index]));
+    for(DeferredGcode* deferred = this->first_gcode; deferred != NULL; deferred = deferred->next){
+        kernel->call_event(ON_GCODE_EXECUTE, &(deferred->gcode));
+    }
+}
+
+// Give the attached gcodes back to the pool, from the main loop once the block is done ( see Conveyor::on_idle )
+void Block::clear_gcodes(){
+    DeferredGcode* deferred = this->first_gcode;
+    this->first_gcode = NULL;
+    this->last_gcode = NULL;
+    while( deferred != NULL ){
+        DeferredGcode* next = deferred->next;
+        this->conveyor->gcode_pool.give(deferred);
+        deferred = next;
     }
 }
 
@@ -202,6 +220,8 @@ void Block::release(){
         Conveyor* conveyor = this->conveyor;
         if( conveyor->queue.size() > conveyor->flush_blocks ){
             conveyor->flush_blocks++;
+            // Anything waiting for room in the queue wants Conveyor::on_idle to run now
+            conveyor->kernel->request_idle();
         }
 
         // We don't look for the next block to execute if the conveyor is already doing that itself
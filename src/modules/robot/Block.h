@@ -14,6 +14,7 @@ using namespace std;
 #include <vector>
 
 #include "../communication/utils/Gcode.h"
+#include "GcodePool.h"
 #include "Planner.h"
 class Planner;
 class Conveyor;
@@ -31,14 +32,15 @@ class Block {
         void debug(Kernel* kernel);
         void append_gcode(Gcode* gcode);
         void pop_and_execute_gcode(Kernel* &kernel);
+        void clear_gcodes();
         double get_duration_left(unsigned int already_taken_steps);
         void take();
         void release();
         void ready();
 
-        vector<std::string> commands;
         vector<double> travel_distances;
-        vector<Gcode> gcodes;
+        DeferredGcode* first_gcode;        // Gcodes to execute once this block is done, taken from the conveyor's gcode pool
+        DeferredGcode* last_gcode;
 
         unsigned int   steps[3];           // Number of steps for each axis for this block
         unsigned int   steps_event_count;  // Steps for the longest axis
@@ -28,6 +28,7 @@ Conveyor::Conveyor(){
 
 void Conveyor::on_module_loaded(){
     register_for_event(ON_IDLE);
+    this->kernel->set_task(ON_IDLE, this, "conveyor", TASK_PRIORITY_MOTION);
 }
 
 // Delete blocks here, because they can't be deleted in interrupt context ( see Block.cpp:release )
@@ -35,7 +36,7 @@ void Conveyor::on_idle(void* argument){
     if (flush_blocks){
         // Cleanly delete block 
         Block* block = queue.get_tail_ref();
-        block->gcodes.clear(); 
+        block->clear_gcodes();
         queue.delete_first();
         __disable_irq();
         flush_blocks--;
@@ -50,7 +51,7 @@ Block* Conveyor::new_block(){
     Block* block = this->queue.get_tail_ref();
     // Then clean it up
     if( block->conveyor == this ){
-        block->gcodes.clear();
+        block->clear_gcodes();
     }
 
     // Create a new virgin Block in the queue
@@ -110,14 +111,14 @@ void Conveyor::pop_and_process_new_block(int debug){
 // Wait for the queue to have a given number of free blocks
 void Conveyor::wait_for_queue(int free_blocks){
     while( this->queue.size() >= this->queue.capacity()-free_blocks ){
-        this->kernel->call_event(ON_IDLE);
+        this->kernel->idle_wait();
     }
 }
 
 // Wait for the queue to be empty
 void Conveyor::wait_for_empty_queue(){
     while( this->queue.size() > 0){
-        this->kernel->call_event(ON_IDLE);
+        this->kernel->idle_wait();
     }
 }
 
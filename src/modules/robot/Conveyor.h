@@ -10,6 +10,7 @@
 
 #include "libs/Module.h"
 #include "libs/Kernel.h"
+#include "GcodePool.h"
 using namespace std;
 #include <string>
 #include <vector>
@@ -29,6 +30,7 @@ class Conveyor : public Module {
         bool is_queue_empty();
 
         RingBuffer<Block,16> queue;  // Queue of Blocks
+        GcodePool gcode_pool;        // Where blocks keep their gcodes
         Block* current_block;
         bool looking_for_new_block;
 
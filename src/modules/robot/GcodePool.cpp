@@ -0,0 +1,55 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GcodePool.h"
+#include "libs/StreamOutput.h"
+#include <ahbmalloc.h>
+#include <new>
+
+GcodePool::GcodePool(){
+    // ahbmalloc does not align what it returns, and a Gcode holds a double
+    uintptr_t memory = (uintptr_t)ahbmalloc(GCODE_POOL_SIZE * sizeof(DeferredGcode) + 7, AHB_BANK_0);
+    this->slots = (DeferredGcode*)( ( memory + 7 ) & ~(uintptr_t)7 );
+    for( int i = 0; i < GCODE_POOL_SIZE; i++ ){
+        this->free_slots[i] = GCODE_POOL_SIZE - 1 - i;
+    }
+    // No AHB RAM left, every gcode goes to the heap as it used to
+    this->free_count = ( memory == 0 ) ? 0 : GCODE_POOL_SIZE;
+    this->used_max   = 0;
+    this->overflows  = 0;
+    this->on_heap    = 0;
+}
+
+// Copy a gcode into a free slot. Called from the main loop with interrupts off ( see Block::append_gcode )
+DeferredGcode* GcodePool::take(const Gcode& gcode){
+    if( this->free_count == 0 ){
+        this->overflows++;
+        this->on_heap++;
+        return new DeferredGcode(gcode);
+    }
+    DeferredGcode* deferred = new (&this->slots[this->free_slots[--this->free_count]]) DeferredGcode(gcode);
+    uint8_t used = GCODE_POOL_SIZE - this->free_count;
+    if( used > this->used_max ){ this->used_max = used; }
+    return deferred;
+}
+
+// The block is done with it
+void GcodePool::give(DeferredGcode* deferred){
+    if( deferred < this->slots || deferred >= this->slots + GCODE_POOL_SIZE ){
+        this->on_heap--;
+        delete deferred;
+        return;
+    }
+    deferred->~DeferredGcode();
+    this->free_slots[this->free_count++] = deferred - this->slots;
+}
+
+// For the "mem" console command
+void GcodePool::report(StreamOutput* stream){
+    stream->printf("Gcode pool: %u of %u slots used, %u at most, %lu went to the heap ( %u still there )\r\n",
+                   GCODE_POOL_SIZE - this->free_count, GCODE_POOL_SIZE, this->used_max, (unsigned long)this->overflows, this->on_heap);
+}
@@ -0,0 +1,43 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GCODEPOOL_H
+#define GCODEPOOL_H
+
+#include "../communication/utils/Gcode.h"
+#include <stdint.h>
+
+class StreamOutput;
+
+#define GCODE_POOL_SIZE 32      // Two gcodes for each block of the queue : a move, and one of the M codes that wait for it
+
+// A copy of a gcode, waiting in a block for on_gcode_execute. Blocks chain theirs through next
+struct DeferredGcode {
+    DeferredGcode(const Gcode& gcode) : gcode(gcode), next(NULL) {}
+    Gcode          gcode;
+    DeferredGcode* next;
+};
+
+// Fixed slots for the gcodes attached to blocks, in AHB RAM, so a long print does not carve up the heap one gcode at a time
+// When every slot is taken the gcode goes to the heap, which is counted : the "mem" console command shows how full the pool got
+class GcodePool {
+    public:
+        GcodePool();
+        DeferredGcode* take(const Gcode& gcode);
+        void give(DeferredGcode* deferred);
+        void report(StreamOutput* stream);
+
+    private:
+        DeferredGcode* slots;
+        uint8_t  free_slots[GCODE_POOL_SIZE];   // Indexes of the free slots, as a stack
+        uint8_t  free_count;
+        uint8_t  used_max;                      // High water mark
+        uint32_t overflows;                     // Gcodes that found no free slot
+        uint16_t on_heap;                       // ... and are still on the heap
+};
+
+#endif
@@ -15,6 +15,7 @@ using namespace std;
 #include "Block.h"
 #include "Planner.h"
 #include "Conveyor.h"
+#include "libs/Profiler.h"
 
 // The Planner does the acceleration math for the queue of Blocks ( movements ).
 // It makes sure the speed stays within the configured constraints ( acceleration, junction_deviation, etc )
@@ -154,6 +155,37 @@ void Planner::append_block( int target[], double feed_rate, double distance, dou
 
 }
 
+// Append a block with no XYZ movement, for a module that moves on its own during it ( see Extruder's SOLO mode and firmware retraction )
+// It is planned like any other block : the axes come to a stop before it, and the move after it starts from rest
+Block* Planner::append_solo_block(){
+
+    this->kernel->conveyor->wait_for_queue(2);
+
+    Block* block = this->kernel->conveyor->new_block();
+    block->planner = this;
+
+    block->direction_bits = 0;
+    for( int stepper=ALPHA_STEPPER; stepper<=GAMMA_STEPPER; stepper++){ block->steps[stepper] = 0; }
+    block->steps_event_count = 0;
+    block->millimeters = 0;
+    block->nominal_speed = 0;
+    block->nominal_rate = 0;
+    block->rate_delta = 0;
+
+    block->max_entry_speed = 0;
+    block->entry_speed = 0;
+    block->nominal_length_flag = true;
+    block->recalculate_flag = true;
+
+    // Nothing to join with, the next move starts from rest
+    clear_vector_double(this->previous_unit_vec);
+    this->previous_nominal_speed = 0;
+
+    this->recalculate();
+
+    block->ready();
+    return block;
+}
 
 // Recalculates the motion plan according to the following algorithm:
 //
@@ -172,7 +204,10 @@ void Planner::append_block( int target[], double feed_rate, double distance, dou
 //
 // 3. Recalculate trapezoids for all blocks.
 //
+static ProfileZone recalculate_zone("planner_recalculate");
+
 void Planner::recalculate() {
+   ProfileScope profile(recalculate_zone);
    this->reverse_pass();
    this->forward_pass();
    this->recalculate_trapezoids();
@@ -230,7 +265,8 @@ void Planner::recalculate_trapezoids() {
         next = &this->kernel->conveyor->queue.buffer[block_index];
         if( current ){
             // Recalculate if current block entry or exit junction speed has changed.
-            if( current->recalculate_flag || next->recalculate_flag ){
+            // Solo blocks have no speed to plan for
+            if( ( current->recalculate_flag || next->recalculate_flag ) && current->nominal_speed > 0 ){
                 current->calculate_trapezoid( current->entry_speed/current->nominal_speed, next->entry_speed/current->nominal_speed );
                 current->recalculate_flag = false;
             }
@@ -239,7 +275,9 @@ void Planner::recalculate_trapezoids() {
     }
 
     // Last/newest block in buffer. Exit speed is set with MINIMUM_PLANNER_SPEED. Always recalculated.
-    next->calculate_trapezoid( next->entry_speed/next->nominal_speed, MINIMUM_PLANNER_SPEED/next->nominal_speed); //TODO: Make configuration option
+    if( next->nominal_speed > 0 ){
+        next->calculate_trapezoid( next->entry_speed/next->nominal_speed, MINIMUM_PLANNER_SPEED/next->nominal_speed); //TODO: Make configuration option
+    }
     next->recalculate_flag = false;
 
 }
@@ -26,6 +26,7 @@ class Planner : public Module {
     public:
         Planner();
         void append_block( int target[], double feed_rate, double distance, double deltas[] );
+        Block* append_solo_block();
         double max_allowable_speed( double acceleration, double target_velocity, double distance);
         void recalculate();
         void reverse_pass();
@@ -24,6 +24,7 @@ using std::string;
 #include "arm_solutions/RostockSolution.h"
 #include "arm_solutions/JohannKosselSolution.h"
 #include "arm_solutions/HBotSolution.h"
+#include "modules/utils/player/CompiledJob.h"
 
 #define default_seek_rate_checksum             CHECKSUM("default_seek_rate")
 #define default_feed_rate_checksum             CHECKSUM("default_feed_rate")
@@ -57,6 +58,8 @@ Robot::Robot(){
     clear_vector(this->current_position);
     clear_vector(this->last_milestone);
     this->arm_solution = NULL;
+    this->recorder = NULL;
+    this->replaying = false;
     seconds_per_minute = 60.0;
 }
 
@@ -64,6 +67,25 @@ Robot::Robot(){
 void Robot::on_module_loaded() {
     register_for_event(ON_CONFIG_RELOAD);
     this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('G', 0);
+    this->register_for_gcode('G', 1);
+    this->register_for_gcode('G', 2);
+    this->register_for_gcode('G', 3);
+    this->register_for_gcode('G', 17);
+    this->register_for_gcode('G', 18);
+    this->register_for_gcode('G', 19);
+    this->register_for_gcode('G', 20);
+    this->register_for_gcode('G', 21);
+    this->register_for_gcode('G', 90);
+    this->register_for_gcode('G', 91);
+    this->register_for_gcode('G', 92);
+    this->register_for_gcode('M', 92);
+    this->register_for_gcode('M', 114);
+    this->register_for_gcode('M', 220);
+    this->register_for_gcode('M', 400);
+    this->register_for_gcode('M', 500);
+    this->register_for_gcode('M', 503);
+    this->register_for_gcode('M', 665);
     this->register_for_event(ON_GET_PUBLIC_DATA);
     this->register_for_event(ON_SET_PUBLIC_DATA);
 
@@ -313,6 +335,12 @@ void Robot::on_gcode_received(void * argument){
             this->feed_rate = this->to_millimeters( gcode->get_value('F') ) / 60.0;
     }
 
+    // A replayed move only needs attaching, the compiled job has its milestones and end position
+    if( this->replaying ){
+        if( this->motion_mode != MOTION_MODE_CANCEL ){ this->distance_in_gcode_is_known( gcode ); }
+        return;
+    }
+
     //Perform any physical actions
     switch( next_action ){
         case NEXT_ACTION_DEFAULT:
@@ -337,6 +365,8 @@ void Robot::on_gcode_received(void * argument){
 // and continue
 void Robot::distance_in_gcode_is_known(Gcode* gcode){
 
+    if( this->recorder != NULL ){ this->recorder->set_move_distance( gcode->millimeters_of_travel ); }
+
     //If the queue is empty, execute immediatly, otherwise attach to the last added block
     if( this->kernel->conveyor->queue.size() == 0 ){
         this->kernel->call_event(ON_GCODE_EXECUTE, gcode );
@@ -347,6 +377,56 @@ void Robot::distance_in_gcode_is_known(Gcode* gcode){
 
 }
 
+// Move by deltas ( mm ) at rate ( mm/s ) from wherever the parser is, for modules that add moves of their own without going through
+// the gcode parser, so the job's distance mode, units and rates are untouched ( see Extruder's firmware retraction Z lift )
+void Robot::append_relative_move(double deltas[], double rate){
+    double target[3];
+    for(int axis=X_AXIS;axis<=Z_AXIS;axis++){ target[axis] = this->current_position[axis] + deltas[axis]; }
+    this->append_milestone(target, rate);
+    memcpy(this->current_position, target, sizeof(double)*3);
+}
+
+// Fingerprint of everything that goes into turning gcode into milestones : a compiled job only plays on the configuration it was compiled with
+uint32_t Robot::config_hash(){
+    uint32_t hash = 2166136261u;
+    #define HASH_BYTES(x) do{ const uint8_t* b = (const uint8_t*)&(x); for( size_t i = 0; i < sizeof(x); i++ ){ hash = ( hash ^ b[i] ) * 16777619u; } }while(0)
+
+    // The arm solution is probed rather than hashed, this covers steps per mm and the geometry of any solution
+    double probes[3][3] = { { 0, 0, 0 }, { 10.0, 20.0, 30.0 }, { -50.0, 40.0, 5.0 } };
+    for( int i = 0; i < 3; i++ ){
+        int steps[3];
+        this->arm_solution->millimeters_to_steps( probes[i], steps );
+        HASH_BYTES(steps);
+    }
+    HASH_BYTES(this->max_speeds);
+    HASH_BYTES(this->mm_per_line_segment);
+    HASH_BYTES(this->mm_per_arc_segment);
+    HASH_BYTES(this->delta_segments_per_second);
+    HASH_BYTES(this->arc_correction);
+
+    #undef HASH_BYTES
+    return hash;
+}
+
+// Replay a move from a compiled job. Its gcode goes through on_gcode_received like any other, so the rates and modes it sets are kept
+// and the other modules see it, but we only attach it to the queue, like append_line() would have
+void Robot::replay_move(Gcode* gcode){
+    this->replaying = true;
+    this->kernel->call_event(ON_GCODE_RECEIVED, gcode );
+    this->replaying = false;
+}
+
+// Replay one of the milestones of that move, it was computed when the job was compiled
+void Robot::replay_block(int steps[], double rate, double millimeters, double deltas[]){
+    this->kernel->planner->append_block( steps, rate * seconds_per_minute, millimeters, deltas );
+}
+
+// The move is over, we are where the compiled job says
+void Robot::replay_end(double end_position[]){
+    memcpy(this->current_position, end_position, sizeof(double)*3);
+    memcpy(this->last_milestone, end_position, sizeof(double)*3);
+}
+
 // Reset the position for all axes ( used in homing and G92 stuff )
 void Robot::reset_axis_position(double position, int axis) {
     this->last_milestone[axis] = this->current_position[axis] = position;
@@ -377,6 +457,9 @@ void Robot::append_milestone( double target[], double rate ){
         }
     }
 
+    // Report the milestone if a job is being compiled
+    if( this->recorder != NULL ){ this->recorder->add_block( steps, rate, millimeters_of_travel, deltas ); }
+
     // Append the block to the planner
     this->kernel->planner->append_block( steps, rate * seconds_per_minute, millimeters_of_travel, deltas );
 
@@ -19,6 +19,8 @@ using std::string;
 #include "libs/StepperMotor.h"
 #include "RobotPublicAccess.h"
 
+class CompiledJob;
+
 #define NEXT_ACTION_DEFAULT 0
 #define NEXT_ACTION_DWELL 1
 #define NEXT_ACTION_GO_HOME 2
@@ -55,9 +57,16 @@ class Robot : public Module {
         void get_axis_position(double position[]);
         double to_millimeters(double value);
         double from_millimeters(double value);
+        void append_relative_move(double deltas[], double rate);
+
+        uint32_t config_hash();
+        void replay_move(Gcode* gcode);
+        void replay_block(int steps[], double rate, double millimeters, double deltas[]);
+        void replay_end(double end_position[]);
 
         BaseSolution* arm_solution;                           // Selected Arm solution ( millimeters to step calculation )
         bool absolute_mode;                                   // true for absolute mode ( default ), false for relative mode
+        CompiledJob* recorder;                                // When a job is being compiled, we report the milestones we send to the Planner to it
 
     private:
         void distance_in_gcode_is_known(Gcode* gcode);
@@ -72,6 +81,7 @@ class Robot : public Module {
         double theta(double x, double y);
         void select_plane(uint8_t axis_0, uint8_t axis_1, uint8_t axis_2);
 
+        bool replaying;                                       // A compiled job is replaying a move, its milestones come from the job ( see replay_move )
         double current_position[3];                           // Current position, in millimeters
         double last_milestone[3];                             // Last position, in millimeters
         bool inch_mode;                                       // true for inch mode, false for millimeter mode ( default )
@@ -41,6 +41,10 @@ void Stepper::on_module_loaded(){
     this->register_for_event(ON_BLOCK_END);
     this->register_for_event(ON_GCODE_EXECUTE);
     this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('M', 17);
+    this->register_for_gcode('M', 18);
+    this->register_for_gcode('M', 84);
+    this->register_for_gcode('M', 970);
     this->register_for_event(ON_PLAY);
     this->register_for_event(ON_PAUSE);
 
@@ -94,7 +98,14 @@ void Stepper::on_gcode_received(void* argument){
             Block* block = this->kernel->conveyor->queue.get_ref( this->kernel->conveyor->queue.size() - 1 );
             block->append_gcode(gcode);
         }
-    }  
+    }
+
+    // M970 reports the step interrupt statistics right away, M970 R clears them once reported
+    if( gcode->has_m && gcode->m == 970 ){
+        gcode->mark_as_taken();
+        this->kernel->step_ticker->report_stats(gcode->stream);
+        if( gcode->has_letter('R') ){ this->kernel->step_ticker->reset_stats(); }
+    }
 }
 
 // React to enable/disable gcodes
@@ -290,10 +301,8 @@ uint32_t Stepper::synchronize_acceleration(uint32_t dummy){
         // Because it will set the initial rate
         // We also want to synchronize in case we start accelerating or decelerating now
 
-        // Accel interrupt must happen asap
-        NVIC_SetPendingIRQ(TIMER2_IRQn);
-        // Synchronize both counters
-        LPC_TIM2->TC = LPC_TIM0->TC;
+        // Accel interrupt must happen asap, and the next ones one interval apart from now on
+        this->kernel->slow_ticker->restart(this->acceleration_tick_hook);
 
         // If we start decelerating after this, we must ask the actuator to warn us
         // so we can do what we do in the "else" bellow
@@ -302,9 +311,7 @@ uint32_t Stepper::synchronize_acceleration(uint32_t dummy){
         }
     }else{
         // If we are called not at the first steps, this means we are beginning deceleration
-        NVIC_SetPendingIRQ(TIMER2_IRQn);
-        // Synchronize both counters
-        LPC_TIM2->TC = LPC_TIM0->TC;
+        this->kernel->slow_ticker->restart(this->acceleration_tick_hook);
     }
 
     return 0;
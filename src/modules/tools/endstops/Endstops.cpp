@@ -104,6 +104,13 @@ void Endstops::on_module_loaded()
 
     register_for_event(ON_CONFIG_RELOAD);
     this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('G', 28);
+    this->register_for_gcode('M', 119);
+    this->register_for_gcode('M', 206);
+    this->register_for_gcode('M', 500);
+    this->register_for_gcode('M', 503);
+    this->register_for_gcode('M', 665);
+    this->register_for_gcode('M', 666);
 
     // Take StepperMotor objects from Robot and keep them here
     this->steppers[0] = this->kernel->robot->alpha_stepper_motor;
@@ -187,7 +194,7 @@ void Endstops::wait_for_homed(char axes_to_move)
     unsigned int debounce[3] = {0, 0, 0};
     while (running) {
         running = false;
-        this->kernel->call_event(ON_IDLE);
+        this->kernel->idle_wait();
         for ( char c = 'X'; c <= 'Z'; c++ ) {
             if ( ( axes_to_move >> ( c - 'X' ) ) & 1 ) {
                 if ( this->pins[c - 'X' + (this->home_direction[c - 'X'] ? 0 : 3)].get() ) {
@@ -237,7 +244,7 @@ void Endstops::do_homing(char axes_to_move)
     for ( char c = 'X'; c <= 'Z'; c++ ) {
         if (  ( axes_to_move >> ( c - 'X' ) ) & 1 ) {
             while ( this->steppers[c - 'X']->moving ) {
-                this->kernel->call_event(ON_IDLE);
+                this->kernel->idle_wait();
             }
         }
     }
@@ -272,7 +279,7 @@ void Endstops::do_homing(char axes_to_move)
             if (  ( axes_to_move >> ( c - 'X' ) ) & 1 ) {
                 //this->kernel->streams->printf("axis %c \r\n", c );
                 while ( this->steppers[c - 'X']->moving ) {
-                    this->kernel->call_event(ON_IDLE);
+                    this->kernel->idle_wait();
                 }
             }
         }
@@ -288,7 +295,7 @@ void Endstops::wait_for_homed_corexy(int axis)
     unsigned int debounce[3] = {0, 0, 0};
     while (running) {
         running = false;
-        this->kernel->call_event(ON_IDLE);
+        this->kernel->idle_wait();
         if ( this->pins[axis + (this->home_direction[axis] ? 0 : 3)].get() ) {
             if ( debounce[axis] < debounce_count ) {
                 debounce[axis] ++;
@@ -326,7 +333,7 @@ void Endstops::corexy_home(int home_axis, bool dirx, bool diry, double fast_rate
 
     // wait until done
     while ( this->steppers[X_AXIS]->moving || this->steppers[Y_AXIS]->moving) {
-        this->kernel->call_event(ON_IDLE);
+        this->kernel->idle_wait();
     }
 
     // Start moving the axes to the origin slowly
@@ -375,7 +382,7 @@ void Endstops::do_homing_corexy(char axes_to_move)
         // wait until either X or Y hits the endstop
         bool running= true;
         while (running) {
-            this->kernel->call_event(ON_IDLE);
+            this->kernel->idle_wait();
             for(int m=X_AXIS;m<=Y_AXIS;m++) {
                 if(this->pins[m + (this->home_direction[m] ? 0 : 3)].get()) {
                     // turn off motor
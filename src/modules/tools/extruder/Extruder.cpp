@@ -19,6 +19,12 @@
 #define extruder_dir_pin_checksum            CHECKSUM("extruder_dir_pin")
 #define extruder_en_pin_checksum             CHECKSUM("extruder_en_pin")
 #define extruder_max_speed_checksum          CHECKSUM("extruder_max_speed")
+#define extruder_retract_length_checksum            CHECKSUM("extruder_retract_length")
+#define extruder_retract_feedrate_checksum          CHECKSUM("extruder_retract_feedrate")
+#define extruder_recover_length_checksum            CHECKSUM("extruder_recover_length")
+#define extruder_recover_feedrate_checksum          CHECKSUM("extruder_recover_feedrate")
+#define extruder_retract_zlift_length_checksum      CHECKSUM("extruder_retract_zlift_length")
+#define extruder_retract_zlift_feedrate_checksum    CHECKSUM("extruder_retract_zlift_feedrate")
 
 #define extruder_checksum                    CHECKSUM("extruder")
 
@@ -29,6 +35,12 @@
 #define dir_pin_checksum                     CHECKSUM("dir_pin")
 #define en_pin_checksum                      CHECKSUM("en_pin")
 #define max_speed_checksum                   CHECKSUM("max_speed")
+#define retract_length_checksum              CHECKSUM("retract_length")
+#define retract_feedrate_checksum            CHECKSUM("retract_feedrate")
+#define recover_length_checksum              CHECKSUM("recover_length")
+#define recover_feedrate_checksum            CHECKSUM("recover_feedrate")
+#define retract_zlift_length_checksum        CHECKSUM("retract_zlift_length")
+#define retract_zlift_feedrate_checksum      CHECKSUM("retract_zlift_feedrate")
 
 #define max(a,b) (((a) > (b)) ? (a) : (b))
 
@@ -41,6 +53,7 @@ Extruder::Extruder( uint16_t config_identifier ) {
     this->absolute_mode = true;
     this->paused        = false;
     this->single_config = false;
+    this->retracted     = false;
     this->identifier    = config_identifier;
 }
 
@@ -57,6 +70,26 @@ void Extruder::on_module_loaded() {
     this->register_for_event(ON_BLOCK_BEGIN);
     this->register_for_event(ON_BLOCK_END);
     this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('G', 0);
+    this->register_for_gcode('G', 1);
+    this->register_for_gcode('G', 2);
+    this->register_for_gcode('G', 3);
+    this->register_for_gcode('G', 10);
+    this->register_for_gcode('G', 11);
+    this->register_for_gcode('G', 90);
+    this->register_for_gcode('G', 91);
+    this->register_for_gcode('G', 92);
+    this->register_for_gcode('M', 17);
+    this->register_for_gcode('M', 18);
+    this->register_for_gcode('M', 82);
+    this->register_for_gcode('M', 83);
+    this->register_for_gcode('M', 84);
+    this->register_for_gcode('M', 92);
+    this->register_for_gcode('M', 114);
+    this->register_for_gcode('M', 207);
+    this->register_for_gcode('M', 208);
+    this->register_for_gcode('M', 500);
+    this->register_for_gcode('M', 503);
     this->register_for_event(ON_GCODE_EXECUTE);
     this->register_for_event(ON_PLAY);
     this->register_for_event(ON_PAUSE);
@@ -68,6 +101,7 @@ void Extruder::on_module_loaded() {
     this->unstepped_distance = 0;
     this->current_block = NULL;
     this->mode = OFF;
+    this->solo_feed_rate = this->feed_rate;
 
     // Update speed every *acceleration_ticks_per_second*
     // TODO: Make this an independent setting
@@ -94,6 +128,13 @@ void Extruder::on_config_reload(void* argument){
         this->dir_pin.from_string(          this->kernel->config->value(extruder_dir_pin_checksum           )->by_default("nc" )->as_string())->as_output();
         this->en_pin.from_string(           this->kernel->config->value(extruder_en_pin_checksum            )->by_default("nc" )->as_string())->as_output();
 
+        this->retract_length              = this->kernel->config->value(extruder_retract_length_checksum           )->by_default(3)->as_number();
+        this->retract_feedrate            = this->kernel->config->value(extruder_retract_feedrate_checksum         )->by_default(45)->as_number();
+        this->retract_recover_length      = this->kernel->config->value(extruder_recover_length_checksum           )->by_default(0)->as_number();
+        this->retract_recover_feedrate    = this->kernel->config->value(extruder_recover_feedrate_checksum         )->by_default(8)->as_number();
+        this->retract_zlift_length        = this->kernel->config->value(extruder_retract_zlift_length_checksum     )->by_default(0)->as_number();
+        this->retract_zlift_feedrate      = this->kernel->config->value(extruder_retract_zlift_feedrate_checksum   )->by_default(100)->as_number();
+
     }else{
     // If this module was created with the new multi extruder configuration style
 
@@ -106,6 +147,13 @@ void Extruder::on_config_reload(void* argument){
         this->dir_pin.from_string(          this->kernel->config->value(extruder_checksum, this->identifier, dir_pin_checksum           )->by_default("nc" )->as_string())->as_output();
         this->en_pin.from_string(           this->kernel->config->value(extruder_checksum, this->identifier, en_pin_checksum            )->by_default("nc" )->as_string())->as_output();
 
+        this->retract_length              = this->kernel->config->value(extruder_checksum, this->identifier, retract_length_checksum           )->by_default(3)->as_number();
+        this->retract_feedrate            = this->kernel->config->value(extruder_checksum, this->identifier, retract_feedrate_checksum         )->by_default(45)->as_number();
+        this->retract_recover_length      = this->kernel->config->value(extruder_checksum, this->identifier, recover_length_checksum           )->by_default(0)->as_number();
+        this->retract_recover_feedrate    = this->kernel->config->value(extruder_checksum, this->identifier, recover_feedrate_checksum         )->by_default(8)->as_number();
+        this->retract_zlift_length        = this->kernel->config->value(extruder_checksum, this->identifier, retract_zlift_length_checksum     )->by_default(0)->as_number();
+        this->retract_zlift_feedrate      = this->kernel->config->value(extruder_checksum, this->identifier, retract_zlift_feedrate_checksum   )->by_default(100)->as_number();
+
     }
 
     // disable by default
@@ -145,13 +193,53 @@ void Extruder::on_gcode_received(void *argument){
             gcode->add_nl = true;
             gcode->mark_as_taken();
 
+        }else if (gcode->m == 207){ // M207 - set retract length S[positive mm] F[feedrate mm/min] Z[additional zlift/hop]
+            if(gcode->has_letter('S')) this->retract_length = gcode->get_value('S');
+            if(gcode->has_letter('F')) this->retract_feedrate = gcode->get_value('F')/60.0; // specified in mm/min converted to mm/sec
+            if(gcode->has_letter('Z')) this->retract_zlift_length = gcode->get_value('Z');
+            gcode->mark_as_taken();
+
+        }else if (gcode->m == 208){ // M208 - set retract recover length S[positive mm surplus to the M207 S*] F[feedrate mm/min]
+            if(gcode->has_letter('S')) this->retract_recover_length = gcode->get_value('S');
+            if(gcode->has_letter('F')) this->retract_recover_feedrate = gcode->get_value('F')/60.0; // specified in mm/min converted to mm/sec
+            gcode->mark_as_taken();
+
         }else if (gcode->m == 500 || gcode->m == 503){// M500 saves some volatile settings to config override file, M503 just prints the settings
             gcode->stream->printf(";E Steps per mm:\nM92 E%1.4f\n", this->steps_per_millimeter);
+            gcode->stream->printf(";E retract length, feedrate, zlift:\nM207 S%1.4f F%1.4f Z%1.4f\n", this->retract_length, this->retract_feedrate*60.0, this->retract_zlift_length);
+            gcode->stream->printf(";E retract recover length, feedrate:\nM208 S%1.4f F%1.4f\n", this->retract_recover_length, this->retract_recover_feedrate*60.0);
             gcode->mark_as_taken();
             return;
         }
     }
 
+    // Firmware retraction : G10 retracts, G11 primes, with the length and rate set by M207/M208, so the slicer does not have to send
+    // ( and we do not have to parse ) a G1 E move for each of them. Only the tool in use retracts, and its Z lift is done once
+    if( gcode->has_g && ( gcode->g == 10 || gcode->g == 11 ) && !gcode->has_letter('L') ){
+        if( !this->kernel->toolsmanager->is_active(this) ){ return; }
+        gcode->mark_as_taken();
+
+        // Ignore a G10 when already retracted, and a G11 when not
+        if( ( gcode->g == 10 ) == this->retracted ){ return; }
+        this->retracted = ( gcode->g == 10 );
+
+        // On recover, lower the head before pushing the filament back in
+        if( gcode->g == 11 && this->retract_zlift_length > 0 ){ this->append_zlift(false); }
+
+        // The gcode sets up the SOLO move for the block the Planner adds for it, the axes stop for it
+        if( this->kernel->conveyor->queue.size() == 0 ){
+            this->kernel->call_event(ON_GCODE_EXECUTE, gcode );
+        }else{
+            Block* block = this->kernel->conveyor->queue.get_ref( this->kernel->conveyor->queue.size() - 1 );
+            block->append_gcode(gcode);
+        }
+        this->kernel->planner->append_solo_block();
+
+        // On retract, lift the head once the filament has been pulled back
+        if( gcode->g == 10 && this->retract_zlift_length > 0 ){ this->append_zlift(true); }
+        return;
+    }
+
     // Gcodes to pass along to on_gcode_execute
     if( ( gcode->has_m && (gcode->m == 17 || gcode->m == 18 || gcode->m == 82 || gcode->m == 83 || gcode->m == 84 || gcode->m == 92 ) ) || ( gcode->has_g && gcode->g == 92 && gcode->has_letter('E') ) || ( gcode->has_g && ( gcode->g == 90 || gcode->g == 91 ) ) ){
         gcode->mark_as_taken();
@@ -198,6 +286,12 @@ Block* Extruder::append_empty_block(){
     return block;
 }
 
+// Queue the Z hop that goes with a retract ( or its reverse on recover ), as a move of its own for the Planner
+void Extruder::append_zlift(bool up){
+    double deltas[3] = { 0, 0, up ? this->retract_zlift_length : -this->retract_zlift_length };
+    this->kernel->robot->append_relative_move(deltas, this->retract_zlift_feedrate);
+}
+
 // Compute extrusion speed based on parameters and gcode distance of travel
 void Extruder::on_gcode_execute(void* argument){
     Gcode* gcode = static_cast<Gcode*>(argument);
@@ -220,8 +314,21 @@ void Extruder::on_gcode_execute(void* argument){
     this->mode = OFF;
 
     if( gcode->has_g ){
+        // G10/G11: Firmware retract and recover, the length is known in advance so there is nothing to parse
+        if( ( gcode->g == 10 || gcode->g == 11 ) && !gcode->has_letter('L') ){
+            if( !this->kernel->toolsmanager->is_active(this) ){ return; }
+            this->mode = SOLO;
+            if( gcode->g == 10 ){
+                this->travel_distance = -this->retract_length;
+                this->solo_feed_rate  = this->retract_feedrate;
+            }else{
+                this->travel_distance = this->retract_length + this->retract_recover_length;
+                this->solo_feed_rate  = this->retract_recover_feedrate;
+            }
+            this->en_pin.set(0);
+
         // G92: Reset extruder position
-        if( gcode->g == 92 ){
+        }else if( gcode->g == 92 ){
             gcode->mark_as_taken();
             if( gcode->has_letter('E') ){
                 this->current_position = gcode->get_value('E');
@@ -268,6 +375,7 @@ void Extruder::on_gcode_execute(void* argument){
                     this->feed_rate = this->max_speed * kernel->robot->seconds_per_minute;
                 feed_rate /= kernel->robot->seconds_per_minute;
             }
+            this->solo_feed_rate = this->feed_rate;
         }else if( gcode->g == 90 ){ this->absolute_mode = true;
         }else if( gcode->g == 91 ){ this->absolute_mode = false;
         }
@@ -341,6 +449,9 @@ void Extruder::on_block_begin(void* argument){
 // When a block ends, pause the stepping interrupt
 void Extruder::on_block_end(void* argument){
     this->current_block = NULL;
+
+    // A SOLO move is one block long, the blocks after it ( like a retract's Z lift ) must not move us again unless a gcode says so
+    if( this->mode == SOLO ){ this->mode = OFF; }
 }
 
 // Called periodically to change the speed to match acceleration or to match the speed of the robot
@@ -350,7 +461,7 @@ uint32_t Extruder::acceleration_tick(uint32_t dummy){
     if( this->current_block == NULL ||  this->paused || this->mode != SOLO ){ return 0; }
 
     uint32_t current_rate = this->stepper_motor->steps_per_second;
-    uint32_t target_rate = int(floor(this->feed_rate * this->steps_per_millimeter));
+    uint32_t target_rate = int(floor(this->solo_feed_rate * this->steps_per_millimeter));
 
     if( current_rate < target_rate ){
         uint32_t rate_increase = int(floor((this->acceleration/this->kernel->stepper->acceleration_ticks_per_second)*this->steps_per_millimeter));
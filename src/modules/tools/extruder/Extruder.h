@@ -34,6 +34,7 @@ class Extruder : public Module, public Tool {
         uint32_t acceleration_tick(uint32_t dummy);
         uint32_t stepper_motor_finished_move(uint32_t dummy);
         Block*   append_empty_block();
+        void     append_zlift(bool up);
 
         Pin             step_pin;                     // Step pin for the stepper driver
         Pin             dir_pin;                      // Dir pin for the stepper driver
@@ -50,8 +51,17 @@ class Extruder : public Module, public Tool {
 
         double          travel_ratio;
         double          travel_distance;
+        double          solo_feed_rate;               // Feed rate for the current SOLO move, either feed_rate or one of the retract rates
         bool            absolute_mode;                // absolute/relative coordinate mode switch
 
+        double          retract_length;               // Firmware retraction settings ( G10/G11, M207/M208 ), in mm and mm/s
+        double          retract_feedrate;
+        double          retract_recover_length;       // Extra length pushed back in on G11 ( on top of retract_length )
+        double          retract_recover_feedrate;
+        double          retract_zlift_length;
+        double          retract_zlift_feedrate;
+        bool            retracted;                    // Whether a G10 is pending its G11
+
         char mode;                                    // extruder motion mode,  OFF, SOLO, or FOLLOW
 
         bool paused;
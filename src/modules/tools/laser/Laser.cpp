@@ -11,6 +11,24 @@
 #include "modules/robot/Stepper.h"
 #include "Laser.h"
 #include "libs/nuts_bolts.h"
+#include "libs/StepperMotor.h"
+#include "ahbmalloc.h"
+#include "libs/StepTicker.h"
+#include "system_LPC17xx.h" // mbed.h lib
+#include <math.h>
+
+// Match register of each PWM1 channel, they are not contiguous
+static __IO uint32_t* const pwm1_match_registers[] = {
+    &(LPC_PWM1->MR0), &(LPC_PWM1->MR1), &(LPC_PWM1->MR2), &(LPC_PWM1->MR3),
+    &(LPC_PWM1->MR4), &(LPC_PWM1->MR5), &(LPC_PWM1->MR6)
+};
+
+// Value of a lowercase hex digit, or -1 if this is not one
+static int hex_value(char c){
+    if( c >= '0' && c <= '9' ){ return c - '0'; }
+    if( c >= 'a' && c <= 'f' ){ return c - 'a' + 10; }
+    return -1;
+}
 
 Laser::Laser(){
 }
@@ -25,24 +43,60 @@ void Laser::on_module_loaded() {
     // Get smoothie-style pin from config
     Pin* dummy_pin = new Pin();
     dummy_pin->from_string(this->kernel->config->value(laser_module_pin_checksum)->by_default("nc")->as_string())->as_output();
-    
-    // Get mBed-style pin from smoothie-style pin
-    if( dummy_pin->port_number == 2 ){
-        if( dummy_pin->pin == 0 ){ this->laser_pin = new mbed::PwmOut(p26); }
-        if( dummy_pin->pin == 1 ){ this->laser_pin = new mbed::PwmOut(p25); }
-        if( dummy_pin->pin == 2 ){ this->laser_pin = new mbed::PwmOut(p24); }
-        if( dummy_pin->pin == 3 ){ this->laser_pin = new mbed::PwmOut(p23); }
-        if( dummy_pin->pin == 4 ){ this->laser_pin = new mbed::PwmOut(p22); }
-        if( dummy_pin->pin == 5 ){ this->laser_pin = new mbed::PwmOut(p21); }
+
+    // Only P2.0 to P2.5 are PWM1 outputs ( channels 1 to 6 )
+    if( dummy_pin->port_number != 2 || dummy_pin->pin > 5 ){
+        this->kernel->streams->printf("Error: laser_module_pin must be one of P2.0 to P2.5\r\n");
+        delete dummy_pin;
+        delete this;
+        return;
     }
+    this->laser_channel = dummy_pin->pin + 1;
+    this->laser_match = pwm1_match_registers[this->laser_channel];
 
-    this->laser_pin->period_us(20);
-    this->laser_pin->write(0);
+    // We drive PWM1 ourselves rather than through mbed::PwmOut, as the duty cycle is written from the step and acceleration interrupts
+    // Nothing else in the firmware uses PWM1, but the period is shared by all its channels : if it is already running, keep its period
+    if( LPC_PWM1->TCR & (1 << 3) ){
+        this->laser_period = LPC_PWM1->MR0;
+    }else{
+        LPC_SC->PCONP |= (1 << 6);                          // Power PWM1 ON
+        LPC_SC->PCLKSEL0 &= ~(0x3 << 12);                   // PCLK = CCLK/4
+        LPC_PWM1->TCR = 2;                                  // Reset
+        LPC_PWM1->PR  = 0;                                  // No prescale
+        LPC_PWM1->MCR = (1 << 1);                           // Reset on MR0
+        this->laser_period = (SystemCoreClock/4) / 50000;   // 20us period
+        LPC_PWM1->MR0 = this->laser_period;
+        LPC_PWM1->LER |= (1 << 0);
+    }
+    *this->laser_match = 0;
+    LPC_PWM1->LER |= (1 << this->laser_channel);
+    LPC_PWM1->PCR |= (1 << (8 + this->laser_channel));      // Single edge, output enabled
+    LPC_PWM1->TCR = (1 << 0) | (1 << 3);                    // Counter and PWM enabled
+    LPC_PINCON->PINSEL4 = ( LPC_PINCON->PINSEL4 & ~(0x3 << (2 * dummy_pin->pin)) ) | (0x1 << (2 * dummy_pin->pin));
+    delete dummy_pin;
 
     this->laser_max_power = this->kernel->config->value(laser_module_max_power_checksum)->by_default(0.8)->as_number() ;
     this->laser_tickle_power = this->kernel->config->value(laser_module_tickle_power_checksum)->by_default(0)->as_number() ;
+    this->laser_max_ticks = uint32_t(this->laser_max_power * this->laser_period);
+    this->load_power_table(this->kernel->config->value(laser_module_power_table_checksum)->by_default("0,1")->as_string());
+    this->velocity_power = 0;
+
+    // Raster scanlines are kept in AHB ram, out of the way of the main heap
+    this->raster_lines = (uint8_t *)ahbmalloc(LASER_RASTER_LINES * LASER_RASTER_MAX_PIXELS, AHB_BANK_0);
+    this->raster_received = 0;
+    this->raster_executed = 0;
+    this->raster_released = 0;
+    this->raster_late = false;
+    this->raster_moving = false;
+    this->raster_pixels = this->raster_lines;
+    this->raster_count = 0;
+    this->raster_index = 0;
+    this->raster_steps = 0;
+    this->raster_pixel = 255;
 
     //register for events
+    this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('G', 1);
     this->register_for_event(ON_GCODE_EXECUTE);
     this->register_for_event(ON_SPEED_CHANGE);
     this->register_for_event(ON_PLAY);
@@ -53,22 +107,84 @@ void Laser::on_module_loaded() {
 
 // Turn laser off laser at the end of a move
 void  Laser::on_block_end(void* argument){
-    this->laser_pin->write(0);
+    this->set_duty(0);
+
+    // A scanline only ever applies to the move it came with, its slot can be reused now, unless it has not even been decoded yet
+    this->raster_released = this->raster_late ? this->raster_executed - 1 : this->raster_executed;
+    this->raster_late = false;
+    this->raster_moving = false;
+    this->raster_count = 0;
+    this->raster_pixel = 255;
 }
 
 // Set laser power at the beginning of a block
 void Laser::on_block_begin(void* argument){
-    this->set_proportional_power();
+    Block* block = static_cast<Block*>(argument);
+
+    // If this move carries a scanline, follow the main stepper so each pixel gets its share of the steps
+    // The Stepper gets this event before us, so main_stepper is already set up for this block
+    this->raster_moving = this->laser_on && this->kernel->stepper->current_block == block;
+    if( this->raster_count > 0 ){
+        if( this->raster_moving ){
+            this->raster_steps = this->kernel->stepper->main_stepper->steps_to_move;
+            this->raster_seek(0);
+        }else{
+            this->raster_count = 0;
+            this->raster_pixel = 255;
+        }
+    }else if( this->raster_late ){
+        // Dark until on_gcode_received catches up with the scanline
+        this->raster_pixel = 0;
+    }
+
+    this->update_velocity_power();
 }
 
 // When the play/pause button is set to pause, or a module calls the ON_PAUSE event
 void Laser::on_pause(void* argument){
-    this->laser_pin->write(0);
+    this->set_duty(0);
 }
 
 // When the play/pause button is set to play, or a module calls the ON_PLAY event
 void Laser::on_play(void* argument){
-    this->set_proportional_power();
+    this->update_velocity_power();
+}
+
+// Decode the scanline of a raster move here in the main loop, so the interrupts only have to pick it up
+// The Robot gets the gcode before us, so its move is queued already, and may have been executed, or even started, if the queue was empty
+void Laser::on_gcode_received(void* argument){
+    Gcode* gcode = static_cast<Gcode*>(argument);
+    if( !gcode->has_g || gcode->g != 1 || !gcode->has_letter('D') ){ return; }
+
+    // The Robot queues nothing for a move this short, so it will not be executed either
+    if( gcode->millimeters_of_travel < 0.0001 ){ return; }
+
+    // Wait for a free slot, the raster moves ahead of this one free theirs as they end
+    while( uint8_t(this->raster_received - this->raster_released) >= LASER_RASTER_LINES ){
+        this->kernel->idle_wait();
+    }
+    uint8_t line = this->raster_received;
+    uint8_t slot = line % LASER_RASTER_LINES;
+    this->raster_lengths[slot] = this->raster_decode(gcode, this->raster_lines + slot * LASER_RASTER_MAX_PIXELS);
+
+    __disable_irq();
+    this->raster_received = line + 1;
+    if( uint8_t(this->raster_executed - line) > 0 ){
+        if( this->raster_late && uint8_t(this->raster_executed - 1) == line ){
+            // Its move is waiting for it, join in wherever the main stepper is
+            this->raster_late = false;
+            this->raster_use(line);
+            if( this->raster_moving ){
+                this->raster_steps = this->kernel->stepper->main_stepper->steps_to_move;
+                this->raster_seek(this->kernel->stepper->main_stepper->stepped);
+                this->set_proportional_power();
+            }
+        }else{
+            // Its move is already over
+            this->raster_released = line + 1;
+        }
+    }
+    __enable_irq();
 }
 
 // Turn laser on/off depending on received GCodes
@@ -78,14 +194,20 @@ void Laser::on_gcode_execute(void* argument){
     if( gcode->has_g){
         int code = gcode->g;
         if( code == 0 ){                    // G0
-            this->laser_pin->write(this->laser_tickle_power);
+            this->set_duty(uint32_t(this->laser_tickle_power * this->laser_period));
             this->laser_on =  false;
         }else if( code >= 1 && code <= 3 ){ // G1, G2, G3
             this->laser_on =  true;
+            if( code == 1 && gcode->has_letter('D') ){
+                uint8_t line = this->raster_executed++;
+                this->raster_late = ( this->raster_received == line );
+                if( !this->raster_late ){ this->raster_use(line); }
+            }
         }
     }
     if ( gcode->has_letter('S' )){
         this->laser_max_power = gcode->get_value('S');
+        this->laser_max_ticks = uint32_t(this->laser_max_power * this->laser_period);
 //         this->kernel->streams->printf("Adjusted laser power to %d/100\r\n",(int)(this->laser_max_power*100.0+0.5));
     }
 
@@ -94,13 +216,133 @@ void Laser::on_gcode_execute(void* argument){
 // We follow the stepper module here, so speed must be proportional
 void Laser::on_speed_change(void* argument){
     if( this->laser_on ){
-        this->set_proportional_power();
+        this->update_velocity_power();
     }
 }
 
+// Look up the power for the actual velocity, as a ratio of the block's nominal velocity, then set the duty cycle
+// This is called from the acceleration interrupt, so it is all integer math, from the step rates the Stepper already has
+void Laser::update_velocity_power(){
+    Stepper* stepper = this->kernel->stepper;
+    Block* block = stepper->current_block;
+    if( !this->laser_on || block == NULL || block->nominal_rate == 0 ){ return; }
+
+    // Velocity ratio, Q16. Both rates are scaled down until the nominal one fits in 16 bits, so this is a 32 bit division
+    uint32_t nominal = block->nominal_rate;
+    uint32_t rate    = uint32_t(stepper->trapezoid_adjusted_rate);
+    if( rate > nominal ){ rate = nominal; }
+    int shift = 16 - __builtin_clz(nominal);
+    if( shift > 0 ){
+        nominal >>= shift;
+        rate    >>= shift;
+    }
+    uint32_t ratio = (rate << 16) / nominal;
+
+    // Interpolate in the power table
+    uint32_t index    = ratio >> LASER_POWER_TABLE_SHIFT;
+    int32_t  fraction = ratio & ((1 << LASER_POWER_TABLE_SHIFT) - 1);
+    int32_t  power    = this->power_table[index];
+    if( index < LASER_POWER_TABLE_SIZE ){
+        power += ( (int32_t(this->power_table[index + 1]) - power) * fraction ) >> LASER_POWER_TABLE_SHIFT;
+    }
+    this->velocity_power = power;
+
+    this->set_proportional_power();
+}
+
+// Adjust power to maximum power, actual velocity and current raster pixel
+// This is called from the step interrupt at each new pixel, velocity_power is already worked out
 void Laser::set_proportional_power(){
-    if( this->laser_on && this->kernel->stepper->current_block ){
-        // adjust power to maximum power and actual velocity
-        this->laser_pin->write(float(double(this->laser_max_power) * double(this->kernel->stepper->trapezoid_adjusted_rate) / double(this->kernel->stepper->current_block->nominal_rate)));
+    if( !this->laser_on || this->kernel->stepper->current_block == NULL ){ return; }
+    this->set_duty( uint32_t( ( uint64_t(this->velocity_power) * this->laser_max_ticks * this->raster_pixel ) >> 16 ) / 255 );
+}
+
+// Write the PWM match register, the new value is latched at the start of the next PWM period
+void Laser::set_duty(uint32_t ticks){
+    if( ticks > this->laser_period ){ ticks = this->laser_period; }
+    *this->laser_match = ticks;
+    LPC_PWM1->LER |= (1 << this->laser_channel);
+}
+
+// Build the power-vs-velocity table from a comma separated list of power ratios for evenly spaced velocity ratios from 0 to 1
+// "0,1" ( the default ) is power proportional to velocity, "1,1" is constant power
+void Laser::load_power_table(string values){
+    vector<double> points;
+    const char* cs = values.c_str();
+    char* cn = NULL;
+    while( *cs ){
+        double value = strtod(cs, &cn);
+        if( cn == cs ){ cs++; continue; }
+        points.push_back(value);
+        cs = cn;
+    }
+    if( points.size() < 2 ){
+        points.clear();
+        points.push_back(0);
+        points.push_back(1);
+    }
+
+    for( int i = 0; i <= LASER_POWER_TABLE_SIZE; i++ ){
+        double position = double(i) * double(points.size() - 1) / LASER_POWER_TABLE_SIZE;
+        unsigned int segment = min( (unsigned int)floor(position), (unsigned int)points.size() - 2 );
+        double power = points[segment] + ( points[segment + 1] - points[segment] ) * ( position - segment );
+        power = max( 0.0, min( 1.0, power ) );
+        this->power_table[i] = uint32_t( power * 65536.0 );
+    }
+}
+
+// Read the scanline of a raster move : G1 X.. Y.. D<hex> where D is followed by two lowercase hex digits per pixel
+// Lowercase keeps the data from being mistaken for gcode letters when the line is split and parsed
+uint16_t Laser::raster_decode(Gcode* gcode, uint8_t* pixels){
+    const char* cs = gcode->command.c_str();
+    while( *cs && *cs != 'D' ){ cs++; }
+    if( *cs ){ cs++; }
+
+    uint16_t count = 0;
+    while( count < LASER_RASTER_MAX_PIXELS ){
+        int high = hex_value(cs[0]);
+        if( high < 0 ){ break; }
+        int low = hex_value(cs[1]);
+        if( low < 0 ){ break; }
+        pixels[count++] = (high << 4) | low;
+        cs += 2;
     }
+    return count;
+}
+
+// Make a decoded scanline the one for the current move
+void Laser::raster_use(uint8_t line){
+    uint8_t slot = line % LASER_RASTER_LINES;
+    this->raster_pixels = this->raster_lines + slot * LASER_RASTER_MAX_PIXELS;
+    this->raster_count  = this->raster_lengths[slot];
+    this->raster_index  = 0;
+}
+
+// Find which pixel we are at after this many steps of the block, and ask the main stepper to signal us when the next one starts
+void Laser::raster_seek(uint32_t stepped){
+    // Pixel n starts at step n * steps / count, pixels narrower than a step are skipped
+    uint16_t index = this->raster_index;
+    if( stepped == 0 ){ index = 0; }
+    uint32_t next_step = 0;
+    while( index + 1 < this->raster_count ){
+        next_step = uint32_t( (uint64_t(index + 1) * this->raster_steps) / this->raster_count );
+        if( next_step > stepped ){ break; }
+        index++;
+    }
+    this->raster_index = index;
+    this->raster_pixel = this->raster_pixels[index];
+
+    StepperMotor* main_stepper = this->kernel->stepper->main_stepper;
+    if( index + 1 < this->raster_count ){
+        main_stepper->attach_signal_pixel(next_step, this, &Laser::raster_step);
+    }else{
+        main_stepper->signal_pixel = false;
+    }
+}
+
+// Called by the main stepper, from the step interrupt, when a new pixel starts
+uint32_t Laser::raster_step(uint32_t dummy){
+    this->raster_seek(this->kernel->stepper->main_stepper->stepped);
+    this->set_proportional_power();
+    return 0;
 }
@@ -12,13 +12,20 @@
 #include "libs/Pin.h"
 #include "libs/Kernel.h"
 #include "modules/communication/utils/Gcode.h"
-#include "PwmOut.h" // mbed.h lib
+#include <string>
+using std::string;
 
 
 #define laser_module_enable_checksum        CHECKSUM("laser_module_enable")
 #define laser_module_pin_checksum           CHECKSUM("laser_module_pin")
 #define laser_module_max_power_checksum     CHECKSUM("laser_module_max_power")
 #define laser_module_tickle_power_checksum  CHECKSUM("laser_module_tickle_power")
+#define laser_module_power_table_checksum   CHECKSUM("laser_module_power_table")
+
+#define LASER_RASTER_MAX_PIXELS             512 // size of a scanline buffer, in pixels
+#define LASER_RASTER_LINES                  4   // scanlines decoded ahead of the move that is running, must divide 256
+#define LASER_POWER_TABLE_SHIFT             11  // velocity ratios are Q16, this many low bits are interpolated between table entries
+#define LASER_POWER_TABLE_SIZE              (1 << (16 - LASER_POWER_TABLE_SHIFT))
 
 class Laser : public Module{
     public:
@@ -29,14 +36,42 @@ class Laser : public Module{
         void on_block_begin(void* argument);
         void on_play(void* argument);
         void on_pause(void* argument);
+        void on_gcode_received(void* argument);
         void on_gcode_execute(void* argument);
         void on_speed_change(void* argument);
+        void update_velocity_power();
         void set_proportional_power();
+        void set_duty(uint32_t ticks);
+        void load_power_table(string values);
+        uint32_t raster_step(uint32_t dummy);
+        uint16_t raster_decode(Gcode* gcode, uint8_t* pixels);
+        void raster_use(uint8_t line);
+        void raster_seek(uint32_t stepped);
 
-        mbed::PwmOut*    laser_pin;    // PWM output to regulate the laser power
+        volatile uint32_t* laser_match; // PWM1 match register of the laser pin, regulates the laser power
+        uint8_t          laser_channel;  // PWM1 channel of the laser pin
+        uint32_t         laser_period;   // PWM period, in PCLK ticks
+        uint32_t         laser_max_ticks; // laser_max_power, in PCLK ticks
         bool             laser_on;     // Laser status
         float            laser_max_power; // maximum allowed laser power to be output on the pwm pin
         float            laser_tickle_power; // value used to tickle the laser on moves
+
+        uint8_t*         raster_lines;   // LASER_RASTER_LINES scanlines of power values ( 0-255 ), decoded as their G1s are received, in AHB ram
+        uint16_t         raster_lengths[LASER_RASTER_LINES]; // number of pixels in each of them
+        volatile uint8_t raster_received; // scanlines decoded so far ( main loop ), scanline n is in slot n % LASER_RASTER_LINES
+        volatile uint8_t raster_executed; // raster moves that got to on_gcode_execute
+        volatile uint8_t raster_released; // scanlines whose move is done, their slots can be reused
+        bool             raster_late;    // the current raster move was executed before its scanline was decoded
+        bool             raster_moving;  // the laser is following the main stepper through a block
+
+        uint8_t*         raster_pixels;  // scanline for the current G1
+        uint16_t         raster_count;   // number of pixels in the scanline, 0 when not rastering
+        uint16_t         raster_index;   // pixel currently being output
+        uint32_t         raster_steps;   // steps the main stepper does for this block, the scanline is spread evenly along them
+        uint8_t          raster_pixel;   // power of the current pixel, 255 when not rastering
+
+        uint32_t         power_table[LASER_POWER_TABLE_SIZE + 1]; // power ( Q16 ) for evenly spaced velocity ratios from 0 to 1
+        uint32_t         velocity_power; // power table value for the current velocity, Q16, updated on speed changes
 };
 
 #endif
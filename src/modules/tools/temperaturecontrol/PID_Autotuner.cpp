@@ -20,6 +20,7 @@ void PID_Autotuner::on_module_loaded()
     this->kernel->slow_ticker->attach(20, this, &PID_Autotuner::on_tick );
     register_for_event(ON_IDLE);
     register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('M', 304);
 }
 
 void PID_Autotuner::begin(TemperatureControl *temp, double target, StreamOutput *stream, int ncycles)
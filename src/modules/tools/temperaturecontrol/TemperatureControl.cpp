@@ -20,7 +20,7 @@
 #include "MRI_Hooks.h"
 
 TemperatureControl::TemperatureControl(uint16_t name) :
-  name_checksum(name), waiting(false), min_temp_violated(false) {}
+  name_checksum(name), pwm_hook(NULL), reading_hook(NULL), waiting(false), min_temp_violated(false) {}
 
 void TemperatureControl::on_module_loaded(){
 
@@ -56,6 +56,16 @@ void TemperatureControl::on_config_reload(void* argument){
     this->set_m_code          = this->kernel->config->value(temperature_control_checksum, this->name_checksum, set_m_code_checksum)->by_default(104)->as_number();
     this->set_and_wait_m_code = this->kernel->config->value(temperature_control_checksum, this->name_checksum, set_and_wait_m_code_checksum)->by_default(109)->as_number();
     this->get_m_code          = this->kernel->config->value(temperature_control_checksum, this->name_checksum, get_m_code_checksum)->by_default(105)->as_number();
+
+    // The codes we take depend on the settings above
+    this->kernel->clear_gcode_routes(this);
+    this->register_for_gcode('M', this->set_m_code);
+    this->register_for_gcode('M', this->set_and_wait_m_code);
+    this->register_for_gcode('M', this->get_m_code);
+    this->register_for_gcode('M', 301);
+    this->register_for_gcode('M', 303);
+    this->register_for_gcode('M', 500);
+    this->register_for_gcode('M', 503);
     this->readings_per_second = this->kernel->config->value(temperature_control_checksum, this->name_checksum, readings_per_second_checksum)->by_default(20)->as_number();
 
     this->designator          = this->kernel->config->value(temperature_control_checksum, this->name_checksum, designator_checksum)->by_default(string("T"))->as_string();
@@ -106,10 +116,19 @@ void TemperatureControl::on_config_reload(void* argument){
     set_low_on_debug(heater_pin.port_number, heater_pin.pin);
 
     // activate SD-DAC timer
-    this->kernel->slow_ticker->attach( this->kernel->config->value(temperature_control_checksum, this->name_checksum, pwm_frequency_checksum)->by_default(2000)->as_number() , &heater_pin, &Pwm::on_tick);
+    uint32_t pwm_frequency = this->kernel->config->value(temperature_control_checksum, this->name_checksum, pwm_frequency_checksum)->by_default(2000)->as_number();
+    if( this->pwm_hook == NULL ){
+        this->pwm_hook = this->kernel->slow_ticker->attach( pwm_frequency, &heater_pin, &Pwm::on_tick);
+    }else{
+        this->kernel->slow_ticker->set_hook_frequency( this->pwm_hook, pwm_frequency );
+    }
 
     // reading tick
-    this->kernel->slow_ticker->attach( this->readings_per_second, this, &TemperatureControl::thermistor_read_tick );
+    if( this->reading_hook == NULL ){
+        this->reading_hook = this->kernel->slow_ticker->attach( this->readings_per_second, this, &TemperatureControl::thermistor_read_tick );
+    }else{
+        this->kernel->slow_ticker->set_hook_frequency( this->reading_hook, this->readings_per_second );
+    }
     this->PIDdt= 1.0 / this->readings_per_second;
 
     // PID
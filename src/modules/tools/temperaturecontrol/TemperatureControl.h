@@ -9,6 +9,7 @@
 #define temperaturecontrol_h
 
 #include "libs/Pin.h"
+#include "libs/Hook.h"
 #include "Pwm.h"
 #include <math.h>
 
@@ -112,6 +113,8 @@ class TemperatureControl : public Module {
 
         Pin  thermistor_pin;
         Pwm  heater_pin;
+        Hook* pwm_hook;         // SlowTicker hooks, attached the first time the config is loaded, and only re-timed after that
+        Hook* reading_hook;
 
         bool waiting;
         bool min_temp_violated;
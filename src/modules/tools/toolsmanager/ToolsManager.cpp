@@ -12,7 +12,9 @@ using namespace std;
 #include <vector>
 #include "ToolsManager.h"
 
-ToolsManager::ToolsManager(){}
+ToolsManager::ToolsManager(){
+    this->active_tool = 0;
+}
 
 void ToolsManager::on_module_loaded(){
 }
@@ -23,5 +25,10 @@ void ToolsManager::add_tool(Tool* tool_to_add){
     this->tools.push_back( tool_to_add );
 }
 
+// Whether this is the tool in use, for things only one tool must do ( like firmware retraction )
+bool ToolsManager::is_active(Tool* tool){
+    return this->active_tool < this->tools.size() && this->tools[this->active_tool] == tool;
+}
+
 
 
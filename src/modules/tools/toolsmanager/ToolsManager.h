@@ -19,8 +19,10 @@ class ToolsManager : public Module {
 
         void on_module_loaded();
         void add_tool(Tool* tool_to_add);
+        bool is_active(Tool* tool);
 
         vector<Tool*> tools;
+        unsigned int active_tool;     // Index in tools of the tool in use, the first one as tool changes are not supported yet
 };
 
 
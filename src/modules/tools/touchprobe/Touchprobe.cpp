@@ -16,12 +16,14 @@ void Touchprobe::on_module_loaded() {
         return;
     }
     this->probe_rate = 5;
+    this->logfile = NULL;
     // load settings
     this->on_config_reload(this);
     // register event-handlers
     register_for_event(ON_CONFIG_RELOAD);
     register_for_event(ON_GCODE_RECEIVED);
     register_for_event(ON_IDLE);
+    this->kernel->set_task(ON_IDLE, this, "touchprobe", TASK_PRIORITY_UI);
 }
 
 void Touchprobe::on_config_reload(void* argument){
@@ -36,14 +38,22 @@ void Touchprobe::on_config_reload(void* argument){
     if( this->should_log){
         this->filename = this->kernel->config->value(touchprobe_logfile_name_checksum)->by_default("/sd/probe_log.csv")->as_string();
         this->mcode = this->kernel->config->value(touchprobe_log_rotate_mcode_checksum)->by_default(0)->as_int();
-        this->logfile = NULL;
     }
+
+    // G31 probes, the log rotation code is a setting
+    this->kernel->clear_gcode_routes(this);
+    this->register_for_gcode('G', 31);
+    if( this->should_log && this->mcode != 0 ){ this->register_for_gcode('M', this->mcode); }
+
+    // The log stays open between probes, it is buffered and committed from on_idle
+    delete this->logfile;
+    this->logfile = this->should_log ? new AppendFileStream(this->filename.c_str()) : NULL;
 }
 
 void Touchprobe::wait_for_touch(int distance[]){
     unsigned int debounce = 0;
     while(true){
-        this->kernel->call_event(ON_IDLE);
+        this->kernel->idle_wait();
         // if no stepper is moving, moves are finished and there was no touch
         if( ((this->steppers[0]->moving ? 0:1 ) + (this->steppers[1]->moving ? 0:1 ) + (this->steppers[2]->moving ? 0:1 )) == 3 ){
             return;
@@ -74,18 +84,10 @@ void Touchprobe::wait_for_touch(int distance[]){
 }
 
 
-void Touchprobe::flush_log(){
-    //FIXME *sigh* fflush doesn't work as expected, see: http://mbed.org/forum/mbed/topic/3234/ or http://mbed.org/search/?type=&q=fflush
-    //fflush(logfile);
-    fclose(logfile);
-    //can't reopen the file here -> crash
-    logfile = NULL;
-}
-// Workaround for the close<->reopen crash, which itself is a workaround for wrong (or unimplemented) fflush behaviour
+// Commit probe points once they have waited long enough, rather than after every one
 void Touchprobe::on_idle(void* argument){
-    if( this->logfile == NULL) {
-        // NOTE: File creation is buggy, a file may appear but writing to it will fail
-        this->logfile = fopen( filename.c_str(), "a");
+    if( this->logfile != NULL ){
+        this->logfile->idle();
     }
 }
 
@@ -141,8 +143,7 @@ void Touchprobe::on_gcode_received(void* argument)
 
             if( this->should_log ){
                 robot->get_axis_position(pos);
-                fprintf(logfile,"%1.3f %1.3f %1.3f\n", robot->from_millimeters(pos[0]), robot->from_millimeters(pos[1]), robot->from_millimeters(pos[2]) );
-                flush_log();
+                this->logfile->printf("%1.3f %1.3f %1.3f\n", robot->from_millimeters(pos[0]), robot->from_millimeters(pos[1]), robot->from_millimeters(pos[2]) );
             }
         }
     }else if(gcode->has_m) {
@@ -151,8 +152,8 @@ void Touchprobe::on_gcode_received(void* argument)
         // TODO do a actual log rotation
         if( this->mcode != 0 && this->should_log && gcode->m == this->mcode){
             string name;
-            fputs("--\n",logfile);
-            flush_log();
+            this->logfile->puts("--\n");
+            this->logfile->flush();
         }
     }
 }
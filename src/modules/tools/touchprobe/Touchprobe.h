@@ -15,6 +15,7 @@
 #include "modules/communication/utils/Gcode.h"
 #include "libs/StepperMotor.h"
 #include "libs/Pin.h"
+#include "libs/AppendFileStream.h"
 
 #define touchprobe_enable_checksum           CHECKSUM("touchprobe_enable")
 #define touchprobe_log_enable_checksum       CHECKSUM("touchprobe_log_enable")
@@ -27,9 +28,8 @@
 class Touchprobe: public Module {
     private:
         void wait_for_touch(int distance[]);
-        void flush_log();
 
-        FILE*          logfile;
+        AppendFileStream* logfile;
         string         filename;
         StepperMotor*  steppers[3];
         Pin            pin;
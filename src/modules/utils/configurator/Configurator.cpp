@@ -15,30 +15,25 @@
 
 
 void Configurator::on_module_loaded(){
-    this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
+    this->register_for_command(config_get_command_checksum);
+    this->register_for_command(config_set_command_checksum);
+    this->register_for_command(config_load_command_checksum);
 //    this->register_for_event(ON_GCODE_RECEIVED);
 //    this->register_for_event(ON_MAIN_LOOP);
 }
 
-// When a new line is received, check if it is a command, and if it is, act upon it
+// When one of our commands is received, act upon it. The kernel only routes us our own commands, and already took the checksum of the command word
 void Configurator::on_console_line_received( void* argument ){
-    SerialMessage new_message = *static_cast<SerialMessage*>(argument);
-
-    // ignore comments
-    if(new_message.message[0] == ';') return;
-
-    string possible_command = new_message.message;
-
-    // We don't compare to a string but to a checksum of that string, this saves some space in flash memory
-    uint16_t check_sum = get_checksum( possible_command.substr(0,possible_command.find_first_of(" \r\n")) );  // todo: put this method somewhere more convenient
+    SerialMessage* new_message = static_cast<SerialMessage*>(argument);
+    uint16_t check_sum = new_message->command;
 
     // Act depending on command
     if (check_sum == config_get_command_checksum)
-        this->config_get_command(  get_arguments(possible_command), new_message.stream );
+        this->config_get_command(  get_arguments(new_message->message), new_message->stream );
     else if (check_sum == config_set_command_checksum)
-        this->config_set_command(  get_arguments(possible_command), new_message.stream );
+        this->config_set_command(  get_arguments(new_message->message), new_message->stream );
     else if (check_sum == config_load_command_checksum)
-        this->config_load_command(  get_arguments(possible_command), new_message.stream );
+        this->config_load_command(  get_arguments(new_message->message), new_message->stream );
 }
 
 // Process and respond to eeprom gcodes (M50x)
@@ -113,19 +108,19 @@ void Configurator::config_load_command( string parameters, StreamOutput* stream
     string source = shift_parameter(parameters);
     if(source == ""){
         this->kernel->config->config_cache_load();
-        this->kernel->call_event(ON_CONFIG_RELOAD);
+        this->kernel->reload_config();
         stream->printf( "Reloaded settings\r\n" );
     } else if(file_exists(source)){
         FileConfigSource fcs(source);
         fcs.transfer_values_to_cache(&this->kernel->config->config_cache);
-        this->kernel->call_event(ON_CONFIG_RELOAD);
+        this->kernel->reload_config();
         stream->printf( "Loaded settings from %s\r\n", source.c_str() );
     } else {
         uint16_t source_checksum = get_checksum(source);
         for(unsigned int i=0; i < this->kernel->config->config_sources.size(); i++){
             if( this->kernel->config->config_sources[i]->is_named(source_checksum) ){
                 this->kernel->config->config_sources[i]->transfer_values_to_cache(&this->kernel->config->config_cache);
-                this->kernel->call_event(ON_CONFIG_RELOAD);
+                this->kernel->reload_config();
                 stream->printf( "Loaded settings from %s\r\n", source.c_str() );
                 break;
             }
@@ -61,6 +61,7 @@ void CurrentControl::on_module_loaded(){
     }
 
     this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('M', 907);
 }
 
 
@@ -131,7 +131,12 @@ void Panel::on_module_loaded()
     // Register for events
     this->register_for_event(ON_IDLE);
     this->register_for_event(ON_MAIN_LOOP);
+
+    // The screen can wait, the planner can't
+    this->kernel->set_task(ON_IDLE,      this, "panel", TASK_PRIORITY_UI, 0, 5000);
+    this->kernel->set_task(ON_MAIN_LOOP, this, "panel", TASK_PRIORITY_UI, 0, 5000);
     this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('M', 117);
 
     // Refresh timer
     this->kernel->slow_ticker->attach( 20, this, &Panel::refresh_tick );
@@ -193,7 +198,7 @@ void Panel::on_gcode_received(void *argument)
     Gcode *gcode = static_cast<Gcode *>(argument);
     if ( gcode->has_m) {
         if ( gcode->m == 117 ) { // set LCD message
-            this->message = get_arguments(gcode->command);
+            this->message = get_arguments(gcode->command.c_str());
             if (this->message.size() > 20) this->message = this->message.substr(0, 20);
             gcode->mark_as_taken();
         }
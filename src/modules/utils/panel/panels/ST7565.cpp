@@ -9,6 +9,7 @@
 #include "ST7565/glcdfont.h"
 #include "Kernel.h"
 #include "ahbmalloc.h"
+#include "libs/spi.h"
 
 //definitions for lcd
 #define LCDWIDTH 128
@@ -81,6 +82,14 @@ ST7565::ST7565() {
     if(framebuffer == NULL) {
         THEKERNEL->streams->printf("Not enough memory available for frame buffer");
     }
+
+    // Refresh the screen in the background, unless the SD card shares this SSP port and could want it in the middle of a refresh
+    this->dma= NULL;
+    int port= (spi_channel == 1) ? 1 : 0;
+    if(framebuffer != NULL && ::SPI::isr_dispatch[port] == NULL) {
+        this->dma= SSPDMA::get(port);
+        if(this->dma != NULL) this->dma->attach_done(this, &ST7565::page_sent);
+    }
 }
 
 ST7565::~ST7565() {
@@ -89,6 +98,7 @@ ST7565::~ST7565() {
 
 //send commands to lcd
 void ST7565::send_commands(const unsigned char* buf, size_t size){
+    if(this->dma != NULL) this->dma->wait();
     cs.set(0);
     a0.set(0);
     while(size-- >0){
@@ -97,12 +107,17 @@ void ST7565::send_commands(const unsigned char* buf, size_t size){
     cs.set(1);
 }
 
-//send data to lcd
+//send data to lcd, with the DMA if it can reach the buffer
 void ST7565::send_data(const unsigned char* buf, size_t size){
+    if(this->dma != NULL) this->dma->wait();
     cs.set(0);
     a0.set(1);
-    while(size-- >0){
-    	spi->write(*buf++);
+    if(this->dma != NULL && size >= SPI_DMA_MIN_LENGTH && this->dma->start(buf, NULL, size)){
+        this->dma->wait();
+    }else{
+        while(size-- >0){
+            spi->write(*buf++);
+        }
     }
     cs.set(1);
     a0.set(0);
@@ -116,6 +131,14 @@ void ST7565::clear(){
 }
 
 void ST7565::send_pic(const unsigned char* data){
+    // The DMA sends the framebuffer a page at a time, each page starting the next one from the DMA interrupt
+    if(this->dma != NULL && data == this->framebuffer){
+        // Still sending the last refresh, skip this one
+        if(this->dma->busy()) return;
+        send_page(0);
+        return;
+    }
+
     for (int i=0; i<LCDPAGES; i++)
     {
     	set_xy(0, i);
@@ -123,6 +146,30 @@ void ST7565::send_pic(const unsigned char* data){
     }
 }
 
+// Start sending a page of the framebuffer, page_sent is called when it is done
+void ST7565::send_page(int page){
+    this->dma_page= page;
+    set_xy(0, page);
+    cs.set(0);
+    a0.set(1);
+    if(!this->dma->start(framebuffer + page*LCDWIDTH, NULL, LCDWIDTH)){
+        // Can't happen unless the buffer moved out of DMA reach, send it the slow way
+        const unsigned char* buf= framebuffer + page*LCDWIDTH;
+        for(int i= 0; i < LCDWIDTH; i++) spi->write(buf[i]);
+        page_sent(0);
+    }
+}
+
+// Called from the DMA interrupt at the end of each page
+uint32_t ST7565::page_sent(uint32_t failed){
+    cs.set(1);
+    a0.set(0);
+    if(!failed && this->dma_page + 1 < LCDPAGES){
+        send_page(this->dma_page + 1);
+    }
+    return 0;
+}
+
 // set column and page number
 void ST7565::set_xy(int x, int y)
 {
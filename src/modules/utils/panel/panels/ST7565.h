@@ -12,6 +12,8 @@
 #include "mbed.h"
 #include "libs/Pin.h"
 
+class SSPDMA;
+
 class ST7565: public LcdBase {
 public:
 	ST7565();
@@ -39,6 +41,8 @@ public:
 	void set_xy(int x, int y);
 	//send pic to whole screen
 	void send_pic(const unsigned char* data);
+	void send_page(int page);
+	uint32_t page_sent(uint32_t failed);
 	//drawing char
 	int drawChar(int x, int y, unsigned char c, int color);
     // blit a glyph of w pixels wide and h pixels high to x, y. offset pixel position in glyph by x_offset, y_offset.
@@ -52,6 +56,8 @@ private:
     //buffer
 	unsigned char *framebuffer;
 	mbed::SPI* spi;
+	SSPDMA* dma;        // Set when we have the SSP port to ourselves, screen refreshes then run from the DMA interrupt
+	uint8_t dma_page;   // Page being sent by the DMA
 	Pin cs;
 	Pin rst;
 	Pin a0;
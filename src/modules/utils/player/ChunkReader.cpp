@@ -0,0 +1,107 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ChunkReader.h"
+#include <string.h>
+
+ChunkReader::ChunkReader(){
+    this->chunks[0] = this->chunks[1] = NULL;
+    this->chunk_size = 0;
+    this->begin(NULL);
+}
+
+void ChunkReader::set_buffers( char* first, char* second, int size ){
+    this->chunks[0] = first;
+    this->chunks[1] = second;
+    this->chunk_size = size;
+}
+
+// Start reading file, forgetting whatever was read from the previous one
+void ChunkReader::begin( FILE* file ){
+    this->file = file;
+    this->chunk_length[0] = this->chunk_length[1] = 0;
+    this->current_chunk = 0;
+    this->chunk_position = 0;
+    this->next_chunk_ready = false;
+    this->read_count = 0;
+
+    // We do our own buffering
+    if( this->file != NULL ){
+        setvbuf(this->file, NULL, _IONBF, 0);
+    }
+}
+
+// Get the next chunk ready now, when there is time for it, rather than when the current one runs out
+void ChunkReader::prefetch(){
+    if( !this->next_chunk_ready ){ this->fill_chunk( 1 - this->current_chunk ); }
+}
+
+// Read the next chunk of the file into one of the buffers
+void ChunkReader::fill_chunk( int index ){
+    size_t got = fread(this->chunks[index], 1, this->chunk_size, this->file);
+    this->chunk_length[index] = got;
+    this->next_chunk_ready = true;
+}
+
+// Make sure the current chunk has unread bytes, moving on to the other chunk ( reading it now if it was not prefetched ) if needed
+// Returns false at the end of the file
+bool ChunkReader::next_chunk(){
+    if( this->chunk_position < this->chunk_length[this->current_chunk] ){ return true; }
+    int next = 1 - this->current_chunk;
+    if( !this->next_chunk_ready ){ this->fill_chunk( next ); }
+    this->next_chunk_ready = false;
+    this->current_chunk = next;
+    this->chunk_position = 0;
+    return this->chunk_length[next] > 0;
+}
+
+// Cut the next line ( without its newline ) from the chunks and append it to line, returns false when the file is finished
+bool ChunkReader::read_line( string& line ){
+    while( true ){
+        if( !this->next_chunk() ){
+            // End of file, the last line may not have a newline
+            return !line.empty();
+        }
+
+        char* start = this->chunks[this->current_chunk] + this->chunk_position;
+        int available = this->chunk_length[this->current_chunk] - this->chunk_position;
+        char* newline = (char*)memchr(start, '\n', available);
+        if( newline != NULL ){
+            line.append(start, newline - start);
+            this->chunk_position += newline - start + 1;
+            this->read_count += newline - start + 1;
+            return true;
+        }
+        line.append(start, available);
+        this->chunk_position += available;
+        this->read_count += available;
+    }
+}
+
+// Copy the next bytes from the chunks, returns false if the file ends first
+bool ChunkReader::read_bytes( void* destination, size_t length ){
+    uint8_t* out = (uint8_t*)destination;
+    while( length > 0 ){
+        if( !this->next_chunk() ){ return false; }
+        size_t available = this->chunk_length[this->current_chunk] - this->chunk_position;
+        if( available > length ){ available = length; }
+        memcpy(out, this->chunks[this->current_chunk] + this->chunk_position, available);
+        this->chunk_position += available;
+        this->read_count += available;
+        out += available;
+        length -= available;
+    }
+    return true;
+}
+
+// Copy the next bytes without reading them, returns false if the current chunk does not have that many
+bool ChunkReader::peek( void* destination, size_t length ){
+    if( !this->next_chunk() ){ return false; }
+    if( this->chunk_length[this->current_chunk] - this->chunk_position < (int)length ){ return false; }
+    memcpy(destination, this->chunks[this->current_chunk] + this->chunk_position, length);
+    return true;
+}
@@ -0,0 +1,44 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKREADER_H
+#define CHUNKREADER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+using std::string;
+
+// Reads a file in chunks into two buffers : lines and bytes are cut from one while the other holds the next chunk
+// The file is not buffered by stdio, so fread goes straight to f_read, which reads whole sectors directly into our chunk
+class ChunkReader {
+    public:
+        ChunkReader();
+
+        void set_buffers( char* first, char* second, int size );
+        void begin( FILE* file );
+        void prefetch();
+        bool read_line( string& line );
+        bool read_bytes( void* destination, size_t length );
+        bool peek( void* destination, size_t length );
+        unsigned long position(){ return this->read_count; }
+
+    private:
+        void fill_chunk( int index );
+        bool next_chunk();
+
+        FILE* file;
+        char* chunks[2];
+        int chunk_size;
+        int chunk_length[2];
+        int current_chunk;
+        int chunk_position;
+        bool next_chunk_ready;
+        unsigned long read_count;   // Bytes read from the chunks since begin()
+};
+
+#endif // CHUNKREADER_H
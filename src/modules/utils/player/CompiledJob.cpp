@@ -0,0 +1,110 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CompiledJob.h"
+
+// The compiler is the firmware itself : while a file is played with "play file -c", the Robot reports each milestone it sends to the Planner,
+// and we write them out next to the line they came from. See CompiledJob.h for the file layout
+
+CompiledJob::CompiledJob(){
+    this->file = NULL;
+    this->single_move = false;
+    this->move_started = false;
+    this->move_distance = 0;
+}
+
+// Open the output file and write the header
+bool CompiledJob::start(string filename, uint32_t machine_hash){
+    this->file = fopen(filename.c_str(), "w");
+    if( this->file == NULL ){ return false; }
+
+    JobHeader header;
+    header.magic        = JOB_MAGIC;
+    header.version      = JOB_VERSION;
+    header.reserved     = 0;
+    header.machine_hash = machine_hash;
+    fwrite(&header, sizeof(header), 1, this->file);
+    return true;
+}
+
+void CompiledJob::stop(){
+    if( this->file != NULL ){
+        fclose(this->file);
+        this->file = NULL;
+    }
+}
+
+// A line of the gcode file is about to be played
+void CompiledJob::begin_line(const string& line){
+    // Comments are dropped, so letters in them can't be mistaken for parameters when the move is replayed
+    size_t comment = line.find_first_of(";(");
+    this->line.assign(line, 0, comment);
+
+    // Only a line holding one G0 to G3 and nothing else can be replayed from its blocks, anything else is kept as text
+    this->single_move = false;
+    if( this->line.size() > 1 && this->line[0] == 'G' && this->line[1] >= '0' && this->line[1] <= '3' && ( this->line.size() == 2 || this->line[2] < '0' || this->line[2] > '9' ) ){
+        this->single_move = ( this->line.find_first_of("GMT", 1) == string::npos );
+    }
+    this->move_started = false;
+    this->move_distance = 0;
+}
+
+// The Robot attached the line's gcode to the queue, with this distance
+void CompiledJob::set_move_distance(double millimeters){
+    this->move_distance = millimeters;
+}
+
+// The Robot sent a milestone to the Planner
+void CompiledJob::add_block(int steps[], double rate, double millimeters, double deltas[]){
+    if( !this->single_move ){ return; }
+
+    if( !this->move_started ){
+        this->write_text(JOB_RECORD_MOVE);
+        float distance = this->move_distance;
+        fwrite(&distance, sizeof(distance), 1, this->file);
+        this->move_started = true;
+    }
+
+    JobBlock block;
+    for( int i = 0; i < 3; i++ ){
+        block.steps[i]  = steps[i];
+        block.deltas[i] = deltas[i];
+    }
+    block.rate        = rate;
+    block.millimeters = millimeters;
+    fputc(JOB_RECORD_BLOCK, this->file);
+    fwrite(&block, sizeof(block), 1, this->file);
+}
+
+// The line was played, close its move record, or store it as text if it was not a move
+void CompiledJob::end_line(double end_position[]){
+    if( this->move_started ){
+        float end[3] = { (float)end_position[0], (float)end_position[1], (float)end_position[2] };
+        fputc(JOB_RECORD_END, this->file);
+        fwrite(end, sizeof(end), 1, this->file);
+    }else if( !this->line.empty() ){
+        this->write_text(JOB_RECORD_LINE);
+    }
+}
+
+// Record type, then the current line as length and text
+void CompiledJob::write_text(uint8_t type){
+    uint16_t length = this->line.size();
+    fputc(type, this->file);
+    fwrite(&length, sizeof(length), 1, this->file);
+    fwrite(this->line.data(), 1, length, this->file);
+}
+
+// part.gcode compiles to part.job
+string CompiledJob::filename_for(string gcode_filename){
+    size_t dot = gcode_filename.find_last_of('.');
+    size_t slash = gcode_filename.find_last_of('/');
+    if( dot != string::npos && ( slash == string::npos || dot > slash ) ){
+        gcode_filename.erase(dot);
+    }
+    return gcode_filename + ".job";
+}
@@ -0,0 +1,76 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COMPILEDJOB_H
+#define COMPILEDJOB_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+using std::string;
+
+// A compiled job is a gcode file as the Robot saw it : moves are stored as the milestones ( in steps ) the Planner was given,
+// so replaying it skips the arc and line segmentation and the arm solution. The move's gcode is still handed to the modules, for the
+// modal settings ( F ) and anything else they take from it. Everything else is kept as gcode text.
+//
+// File layout, little endian :
+//   header : magic "SJOB", version, machine hash ( see Robot::config_hash, a job only plays on the configuration it was compiled for )
+//   records, each starting with a type byte :
+//     JOB_RECORD_LINE  : uint16 length, text       -> played like any line of a gcode file
+//     JOB_RECORD_MOVE  : uint16 length, text, float distance
+//                                                  -> the text is only attached to the queue ( for Extruder, Laser ... ) as the Robot would
+//     JOB_RECORD_BLOCK : JobBlock                  -> goes directly to the Planner
+//     JOB_RECORD_END   : float end position[3]     -> where the Robot is after the move
+
+#define JOB_MAGIC           0x424F4A53  // "SJOB"
+#define JOB_VERSION         1
+
+#define JOB_RECORD_LINE     1
+#define JOB_RECORD_MOVE     2
+#define JOB_RECORD_BLOCK    3
+#define JOB_RECORD_END      4
+
+struct JobHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t machine_hash;
+} __attribute__ ((packed));
+
+struct JobBlock {
+    int32_t steps[3];       // Target, in steps
+    float   rate;           // mm/s, before the realtime speed override is applied
+    float   millimeters;    // Length of the segment
+    float   deltas[3];      // Movement on each axis, in mm
+} __attribute__ ((packed));
+
+// Writes a compiled job while a gcode file is being played normally
+class CompiledJob {
+    public:
+        CompiledJob();
+        bool start(string filename, uint32_t machine_hash);
+        void stop();
+        bool recording(){ return this->file != NULL; }
+
+        void begin_line(const string& line);
+        void set_move_distance(double millimeters);
+        void add_block(int steps[], double rate, double millimeters, double deltas[]);
+        void end_line(double end_position[]);
+
+        static string filename_for(string gcode_filename);
+
+    private:
+        void write_text(uint8_t type);
+
+        FILE*    file;
+        string   line;           // Current line, without comments
+        bool     single_move;    // Whether the current line is a lone G0-G3, the only kind of line we store as a move
+        double   move_distance;  // Distance the Robot attached to the current line's gcode
+        bool     move_started;   // Whether the move record for the current line was written
+};
+
+#endif
@@ -16,21 +16,39 @@
 #include "DirHandle.h"
 #include "PublicDataRequest.h"
 #include "PlayerPublicAccess.h"
+#include "ahbmalloc.h"
+#include "modules/robot/Robot.h"
 
 void Player::on_module_loaded(){
     this->playing_file = false;
     this->booted = false;
-    this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
+    this->register_for_command(play_command_checksum);
+    this->register_for_command(progress_command_checksum);
+    this->register_for_command(abort_command_checksum);
+    this->register_for_command(cd_command_checksum);
     this->register_for_event(ON_MAIN_LOOP);
+    this->kernel->set_task(ON_MAIN_LOOP, this, "player", TASK_PRIORITY_MOTION, 0, 2000);
     this->register_for_event(ON_SECOND_TICK);
     this->register_for_event(ON_GET_PUBLIC_DATA);
     this->register_for_event(ON_SET_PUBLIC_DATA);
     this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('M', 21);
+    this->register_for_gcode('M', 23);
+    this->register_for_gcode('M', 24);
+    this->register_for_gcode('M', 25);
+    this->register_for_gcode('M', 26);
+    this->register_for_gcode('M', 27);
+    this->register_for_gcode('M', 32);
 
     this->on_boot_gcode = this->kernel->config->value(on_boot_gcode_checksum)->by_default("/sd/on_boot.gcode")->as_string();
     this->on_boot_gcode_enable = this->kernel->config->value(on_boot_gcode_enable_checksum)->by_default(true)->as_bool();
     this->elapsed_secs= 0;
     this->reply_stream= NULL;
+    this->current_file_handler = NULL;
+
+    // Read buffers live in AHB ram, out of the way of the main heap
+    this->reader.set_buffers((char *)ahbmalloc(PLAYER_CHUNK_SIZE, AHB_BANK_1), (char *)ahbmalloc(PLAYER_CHUNK_SIZE, AHB_BANK_1), PLAYER_CHUNK_SIZE);
+    this->reset_reader();
 }
 
 void Player::on_second_tick(void*) {
@@ -39,7 +57,7 @@ void Player::on_second_tick(void*) {
 
 void Player::on_gcode_received(void *argument) {
     Gcode *gcode = static_cast<Gcode*>(argument);
-    string args= get_arguments(gcode->command);
+    string args= get_arguments(gcode->command.c_str());
     if (gcode->has_m) {
         if (gcode->m == 21) { // Dummy code; makes Octoprint happy -- supposed to initialize SD card
             gcode->mark_as_taken();
@@ -56,6 +74,7 @@ void Player::on_gcode_received(void *argument) {
                 fclose(this->current_file_handler);
             }
             this->current_file_handler = fopen( this->filename.c_str(), "r");
+            this->reset_reader();
             // get size of file
             int result = fseek(this->current_file_handler, 0, SEEK_END);
             if (0 != result){
@@ -73,7 +92,6 @@ void Player::on_gcode_received(void *argument) {
                 gcode->stream->printf("File selected\r\n");
             }
 
-            this->played_cnt= 0;
             this->elapsed_secs= 0;
 
         }else if (gcode->m == 24) { // start print
@@ -96,6 +114,7 @@ void Player::on_gcode_received(void *argument) {
 
                 // reload the last file opened
                 this->current_file_handler = fopen( this->filename.c_str(), "r");
+                this->reset_reader();
 
                 if(this->current_file_handler == NULL){
                     gcode->stream->printf("file.open failed: %s\r\n", this->filename.c_str());
@@ -130,6 +149,7 @@ void Player::on_gcode_received(void *argument) {
             }
 
             this->current_file_handler = fopen( this->filename.c_str(), "r");
+            this->reset_reader();
             if(this->current_file_handler == NULL){
                 gcode->stream->printf("file.open failed: %s\r\n", this->filename.c_str());
             }else{
@@ -140,29 +160,20 @@ void Player::on_gcode_received(void *argument) {
 }
 
 
-// When a new line is received, check if it is a command, and if it is, act upon it
+// When one of our commands is received, act upon it. The kernel only routes us our own commands, and already took the checksum of the command word
 void Player::on_console_line_received( void* argument ){
-    SerialMessage new_message = *static_cast<SerialMessage*>(argument);
-
-    // ignore comments
-    if(new_message.message[0] == ';') return;
-
-    string possible_command = new_message.message;
-
-    //new_message.stream->printf("Received %s\r\n", possible_command.c_str());
-
-    // We don't compare to a string but to a checksum of that string, this saves some space in flash memory
-    unsigned short check_sum = get_checksum( possible_command.substr(0,possible_command.find_first_of(" \r\n")) );  // todo: put this method somewhere more convenient
+    SerialMessage* new_message = static_cast<SerialMessage*>(argument);
+    uint16_t check_sum = new_message->command;
 
     // Act depending on command
     if (check_sum == play_command_checksum)
-        this->play_command(  get_arguments(possible_command), new_message.stream );
+        this->play_command(  get_arguments(new_message->message), new_message->stream );
     else if (check_sum == progress_command_checksum)
-        this->progress_command(get_arguments(possible_command),new_message.stream );
+        this->progress_command(get_arguments(new_message->message),new_message->stream );
     else if (check_sum == abort_command_checksum)
-        this->abort_command(get_arguments(possible_command),new_message.stream );
+        this->abort_command(get_arguments(new_message->message),new_message->stream );
     else if (check_sum == cd_command_checksum)
-        this->cd_command(  get_arguments(possible_command), new_message.stream );
+        this->cd_command(  get_arguments(new_message->message), new_message->stream );
 }
 
 // Play a gcode file by considering each line as if it was received on the serial console
@@ -170,9 +181,10 @@ void Player::play_command( string parameters, StreamOutput* stream ){
 
     // Get filename
     this->filename          = this->absolute_from_relative(shift_parameter( parameters ));
-    string options          = shift_parameter( parameters );
+    string options          = shift_parameter( parameters ) + parameters;
 
     this->current_file_handler = fopen( this->filename.c_str(), "r");
+    this->reset_reader();
     if(this->current_file_handler == NULL){
         stream->printf("File not found: %s\r\n", this->filename.c_str());
         return;
@@ -189,6 +201,17 @@ void Player::play_command( string parameters, StreamOutput* stream ){
         this->current_stream = stream;
     }
 
+    // Compile the job while playing it if we were passed the -c option, see CompiledJob
+    if( options.find_first_of("Cc") != string::npos ){
+        string job_filename = CompiledJob::filename_for(this->filename);
+        if( this->compiler.start(job_filename, this->kernel->robot->config_hash()) ){
+            this->kernel->robot->recorder = &this->compiler;
+            stream->printf("  Compiling to %s\r\n", job_filename.c_str());
+        }else{
+            stream->printf("Could not open %s for compiling\r\n", job_filename.c_str());
+        }
+    }
+
     // get size of file
     int result = fseek(this->current_file_handler, 0, SEEK_END);
     if (0 != result){
@@ -199,7 +222,6 @@ void Player::play_command( string parameters, StreamOutput* stream ){
             fseek(this->current_file_handler, 0, SEEK_SET);
             stream->printf("  File size %ld\r\n", file_size);
     }
-    this->played_cnt= 0;
     this->elapsed_secs= 0;
 }
 
@@ -214,6 +236,7 @@ void Player::progress_command( string parameters, StreamOutput* stream ){
     }
 
     if(file_size > 0) {
+        unsigned long played_cnt= this->reader.position();
         unsigned long est= 0;
         if(this->elapsed_secs > 10) {
             unsigned long bytespersec= played_cnt / this->elapsed_secs;
@@ -244,10 +267,10 @@ void Player::abort_command( string parameters, StreamOutput* stream ){
         return;
     }
     playing_file = false;
-    played_cnt= 0;
     file_size= 0;
     this->filename= "";
     fclose(current_file_handler);
+    this->stop_compiling();
     stream->printf("Aborted playing file\r\n");
 }
 
@@ -283,32 +306,38 @@ void Player::on_main_loop(void* argument){
     }
 
     if( this->playing_file ){
-        string buffer;
-        int c;
-        buffer.reserve(20);
-        // Print each line of the file
-        while ((c = fgetc(this->current_file_handler)) != EOF){
-            if (c == '\n'){
-                this->current_stream->printf("%s\n", buffer.c_str());
-                struct SerialMessage message;
-                message.message = buffer;
-                message.stream = this->current_stream;
-                // wait for the queue to have enough room that a serial message could still be received before sending
-                this->kernel->conveyor->wait_for_queue(2);
-                this->kernel->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
-                played_cnt += buffer.size();
-                buffer.clear();
+        // The first bytes tell us if this is a gcode file or a compiled job
+        if( !this->format_checked ){
+            this->format_checked = true;
+            if( !this->check_compiled() ){ return; }
+        }
+
+        // Play lines as long as the queue has room, rather than waiting for it here
+        bool finished = false;
+        for( int lines = 0; lines < PLAYER_LINES_PER_LOOP; lines++ ){
+            if( this->kernel->conveyor->queue.size() >= this->kernel->conveyor->queue.capacity() - 2 ){
+                // Nothing else to do while the queue drains, so this is when we get the next chunk ready
+                this->reader.prefetch();
                 return;
+            }
+            // Compiled jobs are played a record at a time, gcode files a line at a time
+            if( this->compiled ){
+                if( !this->play_record() ){ finished = true; break; }
             }else{
-                buffer += c;
+                if( !this->reader.read_line(this->line) ){ finished = true; break; }
+                this->play_line();
             }
+
+            // The file may have been closed by what we just played ( abort, M26, M32 ... )
+            if( !this->playing_file ){ return; }
         }
+        if( !finished ){ return; }
 
         this->playing_file = false;
         this->filename= "";
-        played_cnt= 0;
         file_size= 0;
         fclose(this->current_file_handler);
+        this->stop_compiling();
 
         if(this->reply_stream != NULL) {
             // if we were printing from an M command from pronterface we need to send this back
@@ -318,6 +347,105 @@ void Player::on_main_loop(void* argument){
     }
 }
 
+// Forget whatever was read from the previous file
+void Player::reset_reader(){
+    this->reader.begin(this->current_file_handler);
+    this->line.clear();
+    this->format_checked = false;
+    this->compiled = false;
+}
+
+// Play a line of a gcode file as if it was received on the serial console
+void Player::play_line(){
+    if( this->compiler.recording() ){ this->compiler.begin_line(this->line); }
+
+    this->current_stream->printf("%s\n", this->line.c_str());
+    struct SerialMessage message;
+    message.message = this->line;
+    message.stream = this->current_stream;
+    this->kernel->call_event(ON_CONSOLE_LINE_RECEIVED, &message);
+    this->line.clear();
+
+    if( this->compiler.recording() ){
+        double position[3];
+        this->kernel->robot->get_axis_position(position);
+        this->compiler.end_line(position);
+    }
+}
+
+// Look for a compiled job header at the start of the file, returns false if the file can't be played
+bool Player::check_compiled(){
+    JobHeader header;
+    if( !this->reader.peek(&header, sizeof(header)) ){ return true; }
+    if( header.magic != JOB_MAGIC ){ return true; }
+
+    StreamOutput* stream = this->reply_stream != NULL ? this->reply_stream : this->kernel->streams;
+    if( header.version != JOB_VERSION || header.machine_hash != this->kernel->robot->config_hash() ){
+        stream->printf("Error: %s was compiled for another version or configuration, compile it again\r\n", this->filename.c_str());
+        this->abort_command("", &(StreamOutput::NullStream));
+        return false;
+    }
+
+    this->reader.read_bytes(&header, sizeof(header));
+    this->compiled = true;
+    return true;
+}
+
+// Play one record of a compiled job, returns false when the job is finished
+bool Player::play_record(){
+    uint8_t type;
+    if( !this->reader.read_bytes(&type, 1) ){ return false; }
+
+    switch( type ){
+        case JOB_RECORD_LINE:
+        case JOB_RECORD_MOVE: {
+            uint16_t length;
+            if( !this->reader.read_bytes(&length, sizeof(length)) ){ return false; }
+            this->line.resize(length);
+            if( length > 0 && !this->reader.read_bytes(&this->line[0], length) ){ return false; }
+            if( type == JOB_RECORD_LINE ){
+                this->play_line();
+            }else{
+                float distance;
+                if( !this->reader.read_bytes(&distance, sizeof(distance)) ){ return false; }
+                Gcode gcode(this->line, this->current_stream);
+                gcode.millimeters_of_travel = distance;
+                this->kernel->robot->replay_move(&gcode);
+                this->line.clear();
+            }
+            return true;
+        }
+
+        case JOB_RECORD_BLOCK: {
+            JobBlock block;
+            if( !this->reader.read_bytes(&block, sizeof(block)) ){ return false; }
+            int steps[3]      = { block.steps[0], block.steps[1], block.steps[2] };
+            double deltas[3]  = { block.deltas[0], block.deltas[1], block.deltas[2] };
+            this->kernel->robot->replay_block(steps, block.rate, block.millimeters, deltas);
+            return true;
+        }
+
+        case JOB_RECORD_END: {
+            float end[3];
+            if( !this->reader.read_bytes(end, sizeof(end)) ){ return false; }
+            double position[3] = { end[0], end[1], end[2] };
+            this->kernel->robot->replay_end(position);
+            return true;
+        }
+    }
+
+    this->kernel->streams->printf("Error: corrupted compiled job %s\r\n", this->filename.c_str());
+    return false;
+}
+
+// Done compiling, close the job file
+void Player::stop_compiling(){
+    if( this->compiler.recording() ){
+        this->kernel->robot->recorder = NULL;
+        this->compiler.stop();
+    }
+}
+
 void Player::on_get_public_data(void* argument) {
     PublicDataRequest* pdr = static_cast<PublicDataRequest*>(argument);
 
@@ -333,7 +461,7 @@ void Player::on_get_public_data(void* argument) {
         static struct pad_progress p;
         if(file_size > 0 && playing_file) {
             p.elapsed_secs= this->elapsed_secs;
-            p.percent_complete= (this->file_size - (this->file_size - this->played_cnt)) * 100 / this->file_size;
+            p.percent_complete= (this->file_size - (this->file_size - this->reader.position())) * 100 / this->file_size;
             p.filename= this->filename;
             pdr->set_data_ptr(&p);
             pdr->set_taken();
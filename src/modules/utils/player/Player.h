@@ -13,6 +13,8 @@
 #include "libs/nuts_bolts.h"
 #include "libs/utils.h"
 #include "libs/StreamOutput.h"
+#include "CompiledJob.h"
+#include "ChunkReader.h"
 
 #define play_command_checksum           CHECKSUM("play")
 #define progress_command_checksum       CHECKSUM("progress")
@@ -21,6 +23,9 @@
 #define on_boot_gcode_checksum          CHECKSUM("on_boot_gcode")
 #define on_boot_gcode_enable_checksum   CHECKSUM("on_boot_gcode_enable")
 
+#define PLAYER_CHUNK_SIZE               2048    // bytes read from the file at once, a multiple of the SD sector size
+#define PLAYER_LINES_PER_LOOP           16      // most lines we play in one main loop call
+
 class Player : public Module {
     public:
         Player(){}
@@ -39,6 +44,12 @@ class Player : public Module {
         void abort_command( string parameters, StreamOutput* stream );
 
     private:
+        void reset_reader();
+        void play_line();
+        bool check_compiled();
+        bool play_record();
+        void stop_compiling();
+
         string current_path;
         string filename;
 
@@ -49,8 +60,15 @@ class Player : public Module {
         StreamOutput* current_stream;
         StreamOutput* reply_stream;
         FILE* current_file_handler;
-        unsigned long file_size, played_cnt;
+        unsigned long file_size;
         unsigned long elapsed_secs;
+
+        ChunkReader reader;     // Also counts the bytes played
+        string line;
+
+        bool format_checked;    // Whether we looked at the start of the file for a compiled job header
+        bool compiled;          // Whether the file being played is a compiled job
+        CompiledJob compiler;   // Writes the compiled job when playing with -c
 };
 
 #endif // PLAYER_H
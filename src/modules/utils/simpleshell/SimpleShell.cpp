@@ -16,6 +16,9 @@
 #include "DirHandle.h"
 #include "mri.h"
 #include "version.h"
+#include "libs/Profiler.h"
+#include "libs/SmallString.h"
+#include "libs/USBDevice/USBSerial/USBSerial.h"
 #include "PublicDataRequest.h"
 
 #include "modules/tools/temperaturecontrol/TemperatureControlPublicAccess.h"
@@ -48,6 +51,9 @@ SimpleShell::ptentry_t SimpleShell::commands_table[] = {
     {CHECKSUM("help"),     &SimpleShell::help_command},
     {CHECKSUM("version"),  &SimpleShell::version_command},
     {CHECKSUM("mem"),      &SimpleShell::mem_command},
+    {CHECKSUM("tasks"),    &SimpleShell::tasks_command},
+    {CHECKSUM("profile"),  &SimpleShell::profile_command},
+    {CHECKSUM("step_stats"), &SimpleShell::step_stats_command},
     {CHECKSUM("get"),      &SimpleShell::get_command},
     {CHECKSUM("set_temp"), &SimpleShell::set_temp_command},
     {CHECKSUM("test"),     &SimpleShell::test_command},
@@ -114,11 +120,15 @@ static void heapWalk(StreamOutput *stream, bool verbose)
 void SimpleShell::on_module_loaded()
 {
     this->current_path = "/";
-    this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
+    for (ptentry_t *p = commands_table; p->pfunc != NULL; ++p) {
+        this->register_for_command(p->command_cs);
+    }
     this->reset_delay_secs = 0;
 
     this->register_for_event(ON_SECOND_TICK);
     this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('M', 20);
+    this->register_for_gcode('M', 30);
 }
 
 void SimpleShell::on_second_tick(void *)
@@ -134,7 +144,7 @@ void SimpleShell::on_second_tick(void *)
 void SimpleShell::on_gcode_received(void *argument)
 {
     Gcode *gcode = static_cast<Gcode *>(argument);
-    string args= get_arguments(gcode->command);
+    string args= get_arguments(gcode->command.c_str());
 
     if (gcode->has_m) {
         if (gcode->m == 20) { // list sd card
@@ -163,23 +173,13 @@ bool SimpleShell::parse_command(unsigned short cs, string args, StreamOutput *st
     return false;
 }
 
-// When a new line is received, check if it is a command, and if it is, act upon it
+// When one of our commands is received, run it
 void SimpleShell::on_console_line_received( void *argument )
 {
-    SerialMessage new_message = *static_cast<SerialMessage *>(argument);
-
-    // ignore comments
-    if (new_message.message[0] == ';') return;
-
-    string possible_command = new_message.message;
-
-    //new_message.stream->printf("Received %s\r\n", possible_command.c_str());
-
-    // We don't compare to a string but to a checksum of that string, this saves some space in flash memory
-    unsigned short check_sum = get_checksum( possible_command.substr(0, possible_command.find_first_of(" \r\n")) ); // todo: put this method somewhere more convenient
+    SerialMessage *new_message = static_cast<SerialMessage *>(argument);
 
-    // find command and execute it
-    parse_command(check_sum, get_arguments(possible_command), new_message.stream);
+    // The kernel only routes us the commands in our table, and already took the checksum of the command word
+    parse_command(new_message->command, get_arguments(new_message->message), new_message->stream);
 }
 
 // Convert a path indication ( absolute or relative ) into a path ( absolute )
@@ -293,9 +293,47 @@ void SimpleShell::mem_command( string parameters, StreamOutput *stream)
     unsigned long m = g_maximumHeapAddress - heap;
     stream->printf("Unused Heap: %lu bytes\r\n", m);
 
+    // Gcodes are kept off the heap, these say how well that is going
+    this->kernel->conveyor->gcode_pool.report(stream);
+    small_string_stats.report(stream);
+    stream->printf("USB serial output dropped: %lu bytes in %lu messages\r\n", USBSerial::tx_dropped, USBSerial::tx_dropped_messages);
+
     heapWalk(stream, verbose);
 }
 
+// print how long the main loop and idle tasks take, -r clears the counts
+void SimpleShell::tasks_command( string parameters, StreamOutput *stream)
+{
+    if( shift_parameter( parameters ) == "-r" ){
+        this->kernel->scheduler->reset_stats();
+        stream->printf("Task statistics cleared\r\n");
+        return;
+    }
+    this->kernel->scheduler->report(stream);
+}
+
+// print the profiling zones, -r clears them
+void SimpleShell::profile_command( string parameters, StreamOutput *stream)
+{
+    if( shift_parameter( parameters ) == "-r" ){
+        ProfileZone::reset_all();
+        stream->printf("Profile cleared\r\n");
+        return;
+    }
+    ProfileZone::report(stream);
+}
+
+// print what the step interrupts have been doing, -r clears it
+void SimpleShell::step_stats_command( string parameters, StreamOutput *stream)
+{
+    if( shift_parameter( parameters ) == "-r" ){
+        this->kernel->step_ticker->reset_stats();
+        stream->printf("Step statistics cleared\r\n");
+        return;
+    }
+    this->kernel->step_ticker->report_stats(stream);
+}
+
 static uint32_t getDeviceType()
 {
 #define IAP_LOCATION 0x1FFF1FF1
@@ -446,12 +484,15 @@ void SimpleShell::help_command( string parameters, StreamOutput *stream )
     stream->printf("Commands:\r\n");
     stream->printf("version\r\n");
     stream->printf("mem [-v]\r\n");
+    stream->printf("tasks [-r] - time spent in main loop and idle tasks\r\n");
+    stream->printf("profile [-r] - time spent in interrupts, events, planning and parsing\r\n");
+    stream->printf("step_stats [-r] - step interrupt overruns, skipped ticks and latencies\r\n");
     stream->printf("ls [folder]\r\n");
     stream->printf("cd folder\r\n");
     stream->printf("pwd\r\n");
     stream->printf("cat file [limit]\r\n");
     stream->printf("rm file\r\n");
-    stream->printf("play file [-v]\r\n");
+    stream->printf("play file [-v] [-c]\r\n");
     stream->printf("progress - shows progress of current play\r\n");
     stream->printf("abort - abort currently playing file\r\n");
     stream->printf("reset - reset smoothie\r\n");
@@ -40,6 +40,9 @@ private:
     void get_command(string parameters, StreamOutput *stream );
     void set_temp_command(string parameters, StreamOutput *stream );
     void mem_command(string parameters, StreamOutput *stream );
+    void tasks_command(string parameters, StreamOutput *stream );
+    void profile_command(string parameters, StreamOutput *stream );
+    void step_stats_command(string parameters, StreamOutput *stream );
     void test_command(string parameters, StreamOutput *stream );
 
     bool parse_command(unsigned short cs, string args, StreamOutput *stream);
@@ -0,0 +1,90 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// How many lines a second the Player's ChunkReader cuts from a large gcode file, for a few chunk sizes ( the Player uses 2048 bytes )
+// Host timings, only good to compare changes. Every line is checked, so this also tests lines split across chunks
+
+#include "modules/utils/player/ChunkReader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CHECK(condition) if( !(condition) ){ printf("ChunkReaderBench: %s:%d: %s failed\n", __FILE__, __LINE__, #condition); exit(1); }
+
+#define LINES   200000
+#define PASSES  5
+
+static double seconds(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Lines as a slicer writes them : mostly extruding moves, with travel moves, comments and blank lines
+static void gcode_line(int i, char* line, size_t size){
+    switch( i % 8 ){
+        case 0:  snprintf(line, size, "G0 X%.3f Y%.3f F9000", (i % 2000) / 10.0, (i % 1500) / 10.0); break;
+        case 5:  snprintf(line, size, "; layer %d, travel", i / 1000); break;
+        case 7:  line[0] = '\0'; break;
+        default: snprintf(line, size, "G1 X%.3f Y%.3f E%.5f", (i % 2000) / 10.0, (i % 1500) / 10.0, i * 0.01234); break;
+    }
+}
+
+int main(){
+    const char* filename = "../host/ChunkReaderBench.gcode";
+    FILE* f = fopen(filename, "w");
+    CHECK( f != NULL );
+    char line[80];
+    for( int i = 0; i < LINES; i++ ){
+        gcode_line(i, line, sizeof(line));
+        fprintf(f, "%s\n", line);
+    }
+    long size = ftell(f);
+    fclose(f);
+
+    int chunk_sizes[] = { 512, 2048, 8192 };
+    for( unsigned int c = 0; c < sizeof(chunk_sizes) / sizeof(*chunk_sizes); c++ ){
+        int chunk_size = chunk_sizes[c];
+        char* first = (char*)malloc(chunk_size);
+        char* second = (char*)malloc(chunk_size);
+        ChunkReader reader;
+        reader.set_buffers(first, second, chunk_size);
+
+        double total = 0;
+        for( int pass = 0; pass < PASSES; pass++ ){
+            FILE* file = fopen(filename, "r");
+            CHECK( file != NULL );
+            string text;
+            int lines = 0;
+            double start = seconds();
+            reader.begin(file);
+            while( reader.read_line(text) ){
+                // The Player plays the line and clears it before reading the next one
+                if( pass == 0 ){
+                    gcode_line(lines, line, sizeof(line));
+                    CHECK( text == line );
+                }
+                text.clear();
+                lines++;
+            }
+            total += seconds() - start;
+            CHECK( lines == LINES );
+            CHECK( reader.position() == (unsigned long) size );
+            fclose(file);
+        }
+
+        // The first pass checks the lines, so it is slower, but the file is then in the host's cache for the others
+        double per_pass = total / PASSES;
+        printf("ChunkReaderBench: %d byte chunks, %d lines ( %ld bytes ) in %.1fms, %.0f lines/s, %.1f MB/s\n",
+               chunk_size, LINES, size, per_pass * 1e3, LINES / per_pass, size / per_pass / 1e6);
+        free(first);
+        free(second);
+    }
+
+    remove(filename);
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// How long a config of several hundred temperature_control.* and switch.* settings takes to load into the ConfigCache,
+// from the text and from the binary cache, and how long a lookup then takes. Host timings, only good to compare changes
+
+#include "libs/ConfigCache.h"
+#include "libs/ConfigSources/FileConfigSource.h"
+#include "libs/utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define CHECK(condition) if( !(condition) ){ printf("ConfigCacheBench: %s:%d: %s failed\n", __FILE__, __LINE__, #condition); exit(1); }
+
+#define LOADS   200         // times each load is timed
+#define LOOKUPS 2000        // times every setting is looked up
+
+static const char* temperature_controls[] = { "hotend", "hotend2", "hotend3", "hotend4", "bed", "chamber" };
+static const char* temperature_settings[] = {
+    "enable", "thermistor_pin", "heater_pin", "thermistor", "beta", "r0", "t0", "r1", "r2", "c1", "c2", "c3",
+    "get_m_code", "set_m_code", "set_and_wait_m_code", "designator", "p_factor", "i_factor", "d_factor", "i_max",
+    "max_pwm", "pwm_frequency", "readings_per_second", "preset1", "preset2", "max_temp"
+};
+static const char* switch_settings[] = { "enable", "input_pin", "input_pin_behavior", "input_on_command", "input_off_command",
+                                         "output_pin", "output_type", "output_on_command", "output_off_command" };
+#define SWITCHES 40
+
+static double seconds(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void clear(ConfigCache& cache){
+    for( unsigned int i = 0; i < cache.size(); i++ )
+        delete cache[i];
+    cache.clear();
+}
+
+// Time loading the file into an empty cache, sorted as the first lookup would
+static double time_load(FileConfigSource& source, ConfigCache& cache){
+    double total = 0;
+    for( int i = 0; i < LOADS; i++ ){
+        clear(cache);
+        double start = seconds();
+        cache.push_back(new ConfigValue());
+        source.transfer_values_to_cache(&cache);
+        cache.sort();
+        total += seconds() - start;
+    }
+    return total / LOADS;
+}
+
+int main(){
+    // A config the way people write them : comments, aligned values, and a trailing comment now and then
+    string config_file = "../host/ConfigCacheBench.txt";
+    FILE* f = fopen(config_file.c_str(), "w");
+    CHECK( f != NULL );
+    vector<string> keys;
+    vector<string> values;
+    for( unsigned int m = 0; m < sizeof(temperature_controls) / sizeof(*temperature_controls); m++ ){
+        fprintf(f, "\n# %s temperature control\n", temperature_controls[m]);
+        for( unsigned int s = 0; s < sizeof(temperature_settings) / sizeof(*temperature_settings); s++ ){
+            char key[80], value[16];
+            snprintf(key, sizeof(key), "temperature_control.%s.%s", temperature_controls[m], temperature_settings[s]);
+            snprintf(value, sizeof(value), "%u.%u", m, s);
+            fprintf(f, "%-50s %-10s%s\n", key, value, s % 4 == 0 ? " # see the wiki" : "");
+            keys.push_back(key);
+            values.push_back(value);
+        }
+    }
+    for( int m = 0; m < SWITCHES; m++ ){
+        fprintf(f, "\n# switch %d\n", m);
+        for( unsigned int s = 0; s < sizeof(switch_settings) / sizeof(*switch_settings); s++ ){
+            char key[80], value[16];
+            snprintf(key, sizeof(key), "switch.switch%d.%s", m, switch_settings[s]);
+            snprintf(value, sizeof(value), "M%d", 1000 + m * 10 + s);
+            fprintf(f, "%-50s %s\n", key, value);
+            keys.push_back(key);
+            values.push_back(value);
+        }
+    }
+    fclose(f);
+
+    FileConfigSource source(config_file);
+    ConfigCache cache;
+
+    // From the text
+    double text_load = time_load(source, cache);
+    CHECK( cache.size() == keys.size() + 1 );
+
+    // From the binary cache, written by the first load that uses it
+    source.binary_cache = true;
+    clear(cache);
+    source.transfer_values_to_cache(&cache);
+    double binary_load = time_load(source, cache);
+    CHECK( cache.size() == keys.size() + 1 );
+
+    // Lookups, with the checksums already made as modules keep them
+    vector<uint16_t> check_sums(keys.size() * 3);
+    for( unsigned int i = 0; i < keys.size(); i++ )
+        get_checksums(&check_sums[i * 3], keys[i]);
+    for( unsigned int i = 0; i < keys.size(); i++ ){
+        ConfigValue* value = cache.lookup(&check_sums[i * 3]);
+        CHECK( value != NULL && value->value == values[i] );
+    }
+    unsigned int found = 0;
+    double start = seconds();
+    for( int n = 0; n < LOOKUPS; n++ ){
+        for( unsigned int i = 0; i < keys.size(); i++ )
+            found += cache.lookup(&check_sums[i * 3]) != NULL;
+    }
+    double lookup = ( seconds() - start ) / ( (double) LOOKUPS * keys.size() );
+    CHECK( found == LOOKUPS * keys.size() );
+
+    printf("ConfigCacheBench: %u settings, load from text %.1fus, from binary cache %.1fus, lookup %.1fns\n",
+           (unsigned int) keys.size(), text_load * 1e6, binary_load * 1e6, lookup * 1e9);
+
+    clear(cache);
+    remove(config_file.c_str());
+    remove("../host/ConfigCacheBench.bin");
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// ConfigCache sorts the values on the first lookup : check lookups, trailing 0x0000 checksums, and that the last source read wins
+
+#include "libs/ConfigCache.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(condition) if( !(condition) ){ printf("ConfigCacheTest: %s:%d: %s failed\n", __FILE__, __LINE__, #condition); exit(1); }
+
+static ConfigValue* make_value(uint16_t first, uint16_t second, uint16_t third, const char* value){
+    ConfigValue* v = new ConfigValue();
+    v->check_sums[0] = first;
+    v->check_sums[1] = second;
+    v->check_sums[2] = third;
+    v->value = value;
+    v->found = true;
+    return v;
+}
+
+static ConfigValue* lookup(ConfigCache& cache, uint16_t first, uint16_t second, uint16_t third){
+    uint16_t check_sums[3] = { first, second, third };
+    return cache.lookup(check_sums);
+}
+
+int main(){
+    ConfigCache cache;
+    CHECK( lookup(cache, 1, 0, 0) == NULL );
+    cache.push_back(new ConfigValue());     // The empty value always comes first, Config does the same
+
+    // Values come in file order, not sorted
+    cache.replace_or_push_back(make_value(0x9000, 0, 0, "nine"));
+    cache.replace_or_push_back(make_value(0x1000, 0x2000, 0x3000, "one two three"));
+    cache.replace_or_push_back(make_value(0x1000, 0x2000, 0x4000, "one two four"));
+    cache.replace_or_push_back(make_value(0x5000, 0, 0, "five"));
+    cache.replace_or_push_back(make_value(0x1000, 0x2000, 0x3000, "one two three again"));
+
+    CHECK( lookup(cache, 0x9000, 0, 0)->value == "nine" );
+    CHECK( lookup(cache, 0x5000, 0, 0)->value == "five" );
+    CHECK( lookup(cache, 0x1000, 0x2000, 0x4000)->value == "one two four" );
+    CHECK( lookup(cache, 0x1000, 0x2000, 0x3000)->value == "one two three again" );
+    CHECK( lookup(cache, 0x1000, 0x2000, 0x5000) == NULL );
+    CHECK( lookup(cache, 0x2000, 0, 0) == NULL );
+    CHECK( lookup(cache, 0xFFFF, 0, 0) == NULL );
+
+    // Trailing 0x0000 checksums match anything
+    CHECK( lookup(cache, 0x1000, 0, 0) != NULL );
+    CHECK( lookup(cache, 0x1000, 0x2000, 0)->check_sums[1] == 0x2000 );
+
+    // The duplicate was dropped by the sort
+    CHECK( cache.size() == 5 );
+
+    // An override read after the config was looked up still wins, and sorts in
+    cache.replace_or_push_back(make_value(0x5000, 0, 0, "five overridden"));
+    cache.replace_or_push_back(make_value(0x0100, 0, 0, "one hundred"));
+    CHECK( lookup(cache, 0x5000, 0, 0)->value == "five overridden" );
+    CHECK( lookup(cache, 0x0100, 0, 0)->value == "one hundred" );
+    CHECK( lookup(cache, 0x9000, 0, 0)->value == "nine" );
+    CHECK( cache.size() == 6 );
+
+    printf("ConfigCacheTest: ok\n");
+    return 0;
+}
@@ -0,0 +1,330 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// FatFs' runs of sectors go through diskio and SDFAT to the SDCard : check they become one CMD18 or CMD25 on the bus, land on the right sectors,
+// and that a card that stops answering makes an error instead of a hang. The card is played byte by byte behind a fake SPI
+
+#include "SDCard.h"
+#include "SDFAT.h"
+#include "diskio.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <vector>
+
+#define CHECK(condition) if( !(condition) ){ printf("SDCardTest: %s:%d: %s failed\n", __FILE__, __LINE__, #condition); exit(1); }
+
+#define CARD_SECTORS 64     // sectors the fake card really stores, its CSD says it has more
+
+// A SDHC card in SPI mode : commands are parsed as they are clocked in, and what the card says back is queued
+class FakeCard {
+public:
+    enum State { IDLE, COMMAND, WRITE_WAIT, MULTI_READ, MULTI_WRITE, RECEIVE_BLOCK, BUSY };
+
+    FakeCard() : memory(CARD_SECTORS * 512, 0) {
+        selected = false;
+        busy_forever = false;
+        state = IDLE;
+        clear_counts();
+    }
+
+    void clear_counts() { memset(count, 0, sizeof(count)); }
+
+    uint8_t exchange(uint8_t b) {
+        if( !selected )
+            return 0xFF;
+
+        switch( state ){
+            case BUSY:
+                return 0x00;
+
+            case COMMAND:
+                command[command_length++] = b;
+                if( command_length == 6 )
+                    execute();
+                return 0xFF;
+
+            case RECEIVE_BLOCK:
+                block[block_length++] = b;
+                if( block_length == 514 ){   // data and checksum
+                    memcpy(&memory[sector * 512], block, 512);
+                    sector++;
+                    out.push_back(0x05);     // data accepted
+                    out.push_back(0x00);     // busy while programming
+                    state = busy_forever ? BUSY : ( multiple ? MULTI_WRITE : IDLE );
+                }
+                return 0xFF;
+
+            default:
+                break;
+        }
+
+        if( state == WRITE_WAIT && b == 0xFE ){
+            start_block(false);
+            return 0xFF;
+        }
+        if( state == MULTI_WRITE && b == 0xFC ){
+            start_block(true);
+            return 0xFF;
+        }
+        if( state == MULTI_WRITE && b == 0xFD ){
+            state = IDLE;
+            out.push_back(0xFF);
+            out.push_back(0x00);             // busy while programming the last block
+            return 0xFF;
+        }
+        if( (b & 0xC0) == 0x40 ){
+            // A command, CMD12 stops a multiple block read wherever it is
+            out.clear();
+            command[0] = b;
+            command_length = 1;
+            state = COMMAND;
+            return 0xFF;
+        }
+
+        if( out.empty() && state == MULTI_READ ){
+            if( sector >= CARD_SECTORS ){
+                out.push_back(0x08);         // data error token : out of range
+            } else {
+                send_block(sector++);
+            }
+        }
+        if( out.empty() )
+            return 0xFF;
+        uint8_t r = out.front();
+        out.pop_front();
+        return r;
+    }
+
+    bool selected;
+    bool busy_forever;      // the card never finishes programming the block it is sent
+    State state;
+    int count[64];          // commands received, by number
+    std::vector<uint8_t> memory;
+
+protected:
+    void start_block(bool is_multiple) {
+        multiple = is_multiple;
+        block_length = 0;
+        state = RECEIVE_BLOCK;
+    }
+
+    void send_block(uint32_t n) {
+        out.push_back(0xFE);
+        out.insert(out.end(), memory.begin() + n * 512, memory.begin() + (n + 1) * 512);
+        out.push_back(0xFF);
+        out.push_back(0xFF);
+    }
+
+    void execute() {
+        int cmd = command[0] & 0x3F;
+        uint32_t arg = (command[1] << 24) | (command[2] << 16) | (command[3] << 8) | command[4];
+        count[cmd]++;
+        state = IDLE;
+        out.push_back(0xFF);                 // the card takes a byte to answer
+
+        bool in_range = arg < CARD_SECTORS;
+        switch( cmd ){
+            case 0:  out.push_back(0x01); break;
+            case 8:  { uint8_t r[] = { 0x01, 0x00, 0x00, 0x01, 0xAA }; out.insert(out.end(), r, r + 5); break; }
+            case 55: out.push_back(0x01); break;
+            case 41: out.push_back(0x00); break;
+            case 58: { uint8_t r[] = { 0x00, 0xC0, 0xFF, 0x80, 0x00 }; out.insert(out.end(), r, r + 5); break; }   // powered up, high capacity
+            case 9: {
+                // CSD version 2, c_size 63 : 64 * 1024 sectors
+                uint8_t csd[16] = { 0x40, 0, 0, 0, 0, 0, 0, 0, 0, 63, 0, 0, 0, 0, 0, 0 };
+                out.push_back(0x00);
+                out.push_back(0xFF);
+                out.push_back(0xFE);
+                out.insert(out.end(), csd, csd + 16);
+                out.push_back(0xFF);
+                out.push_back(0xFF);
+                break;
+            }
+            case 16: out.push_back(0x00); break;
+            case 12: out.push_back(0x00); out.push_back(0x00); break;   // stuff byte, R1, then busy
+            case 17:
+                if( !in_range ){ out.push_back(0x20); break; }
+                out.push_back(0x00);
+                out.push_back(0xFF);
+                send_block(arg);
+                break;
+            case 18:
+                if( !in_range ){ out.push_back(0x20); break; }
+                out.push_back(0x00);
+                sector = arg;
+                state = MULTI_READ;
+                break;
+            case 24:
+                if( !in_range ){ out.push_back(0x20); break; }
+                out.push_back(0x00);
+                sector = arg;
+                state = WRITE_WAIT;
+                break;
+            case 25:
+                if( !in_range ){ out.push_back(0x20); break; }
+                out.push_back(0x00);
+                sector = arg;
+                state = MULTI_WRITE;
+                break;
+            default: out.push_back(0x04); break;   // illegal command
+        }
+    }
+
+    std::deque<uint8_t> out;
+    uint8_t command[6];
+    int command_length;
+    uint8_t block[514];
+    int block_length;
+    bool multiple;
+    uint32_t sector;        // next sector of the transfer
+};
+
+static FakeCard card;
+static uint32_t now_us;
+
+uint8_t SPI::write(uint8_t b) { return card.exchange(b); }
+
+void SPI::transfer(const uint8_t* tx, uint8_t* rx, int length) {
+    for( int i = 0; i < length; i++ ){
+        uint8_t r = write(tx ? tx[i] : 0xFF);
+        if( rx )
+            rx[i] = r;
+    }
+}
+
+int GPIO::operator=(int value) {
+    card.selected = ( value == 0 );
+    return value;
+}
+
+// Every look at the clock takes 10us, so waits that never end still time out
+uint32_t us_ticker_read() { return now_us += 10; }
+
+// A FATFileSystem that is never mounted, only diskio uses it
+namespace mbed {
+
+FATFileSystem *FATFileSystem::_ffs[_DRIVES] = {0};
+
+FATFileSystem::FATFileSystem(const char* n) : FileSystemLike(n) {
+    for(int i = 0; i < _DRIVES; i++) {
+        if(_ffs[i] == 0) {
+            _ffs[i] = this;
+            _fsid = i;
+            return;
+        }
+    }
+}
+
+FATFileSystem::~FATFileSystem() { _ffs[_fsid] = 0; }
+FileHandle *FATFileSystem::open(const char* name, int flags) { return NULL; }
+int FATFileSystem::remove(const char *filename) { return -1; }
+int FATFileSystem::format() { return -1; }
+DirHandle *FATFileSystem::opendir(const char *name) { return NULL; }
+int FATFileSystem::mkdir(const char *name, mode_t mode) { return -1; }
+int FATFileSystem::disk_read_sectors(char *buffer, int sector, int count) { return -1; }            // SDFAT has its own
+int FATFileSystem::disk_write_sectors(const char *buffer, int sector, int count) { return -1; }
+
+} // namespace mbed
+
+// A disk that can only do one block at a time, so runs go through MSD_Disk's loop
+class SingleBlockDisk : public MSD_Disk {
+public:
+    SingleBlockDisk() : memory(CARD_SECTORS * 512, 0), reads(0), writes(0) {}
+    virtual int disk_read(char * data, uint32_t block) { reads++; memcpy(data, &memory[block * 512], 512); return 0; }
+    virtual int disk_write(const char * data, uint32_t block) { writes++; memcpy(&memory[block * 512], data, 512); return 0; }
+    virtual uint32_t disk_blocksize() { return 512; }
+    virtual bool busy() { return false; }
+
+    std::vector<uint8_t> memory;
+    int reads;
+    int writes;
+};
+
+// Each sector of a run gets its own content, so one landing on another shows
+static void fill(BYTE* buffer, int sectors, int seed) {
+    for( int i = 0; i < sectors * 512; i++ )
+        buffer[i] = (BYTE)( seed + i / 512 * 37 + i );
+}
+
+int main(){
+    SDCard sd(p5, p6, p7, p8);
+    SDFAT fat("sd", &sd);
+    SingleBlockDisk single;
+    SDFAT single_fat("single", &single);
+    CHECK( fat._fsid == 0 && single_fat._fsid == 1 );
+
+    CHECK( disk_initialize(0) == 0 );
+    CHECK( sd.card_type() == SDCard::SDCARD_V2HC );
+    CHECK( sd.disk_sectors() == 64 * 1024 );
+    CHECK( card.count[16] == 1 );
+
+    BYTE written[3 * 512];
+    BYTE read[3 * 512];
+
+    // A run of three sectors is one CMD25, and each sector lands where it belongs
+    fill(written, 3, 1);
+    card.clear_counts();
+    CHECK( disk_write(0, written, 10, 3) == RES_OK );
+    CHECK( card.count[25] == 1 );
+    CHECK( card.count[24] == 0 );
+    for( int s = 0; s < 3; s++ )
+        CHECK( memcmp(&card.memory[(10 + s) * 512], written + s * 512, 512) == 0 );
+    CHECK( !sd.busy() );
+
+    // ... and reads back with one CMD18, ended by CMD12
+    card.clear_counts();
+    memset(read, 0, sizeof(read));
+    CHECK( disk_read(0, read, 10, 3) == RES_OK );
+    CHECK( card.count[18] == 1 );
+    CHECK( card.count[12] == 1 );
+    CHECK( card.count[17] == 0 );
+    CHECK( memcmp(read, written, sizeof(read)) == 0 );
+    CHECK( !sd.busy() );
+
+    // A single sector still uses the single block commands
+    fill(written, 1, 2);
+    card.clear_counts();
+    CHECK( disk_write(0, written, 20, 1) == RES_OK );
+    CHECK( disk_read(0, read, 20, 1) == RES_OK );
+    CHECK( card.count[24] == 1 && card.count[17] == 1 );
+    CHECK( card.count[25] == 0 && card.count[18] == 0 && card.count[12] == 0 );
+    CHECK( memcmp(read, written, 512) == 0 );
+
+    // Reading past what the card has is an error, and leaves the card usable
+    CHECK( disk_read(0, read, CARD_SECTORS - 1, 2) != RES_OK );
+    CHECK( disk_read(0, read, 1000, 2) != RES_OK );
+    CHECK( !sd.busy() );
+    CHECK( disk_read(0, read, 10, 2) == RES_OK );
+    fill(written, 2, 1);
+    CHECK( memcmp(read, written, 2 * 512) == 0 );
+
+    // A card that never finishes a write makes an error once the longest a write may take is over
+    fill(written, 2, 3);
+    card.busy_forever = true;
+    uint32_t started = now_us;
+    CHECK( disk_write(0, written, 30, 2) != RES_OK );
+    CHECK( now_us - started >= 500000 );
+    CHECK( !sd.busy() );
+    card.busy_forever = false;
+    card.state = FakeCard::IDLE;
+    CHECK( disk_write(0, written, 30, 2) == RES_OK );
+
+    // A disk without multiple block transfers gets the run one sector after the other, each to its own sector
+    fill(written, 3, 4);
+    CHECK( disk_write(1, written, 5, 3) == RES_OK );
+    CHECK( single.writes == 3 );
+    for( int s = 0; s < 3; s++ )
+        CHECK( memcmp(&single.memory[(5 + s) * 512], written + s * 512, 512) == 0 );
+    CHECK( disk_read(1, read, 5, 3) == RES_OK );
+    CHECK( single.reads == 3 );
+    CHECK( memcmp(read, written, sizeof(read)) == 0 );
+
+    printf("SDCardTest: ok\n");
+    return 0;
+}
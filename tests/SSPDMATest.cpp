@@ -0,0 +1,160 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// SSPDMA against fake channels : a transfer that completes, one the DMA reports an error on, one whose interrupt never comes,
+// and the transfers that must be left to the caller to poll
+
+#include "libs/sspdma.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CHECK(condition) if( !(condition) ){ printf("SSPDMATest: %s:%d: %s failed\n", __FILE__, __LINE__, #condition); exit(1); }
+
+// Channels that count what is done to them, the test says whether they can be used and how the transfer ends
+class FakeChannels : public SSPDMAChannels {
+public:
+    FakeChannels() : reachable(true), waitable(true), setup_works(true), done(false), error(false),
+                     drains(0), setups(0), enables(0), disables(0) {}
+
+    bool can_reach(const void* buffer, int length) { return reachable; }
+    bool can_wait() { return waitable; }
+    void drain() { drains++; }
+    bool setup(const uint8_t* tx, uint8_t* rx, int length) { setups++; return setup_works; }
+    void enable() { enables++; done = false; error = false; }
+    void disable() { disables++; }
+    bool finished() { return done; }
+    bool failed() { return error; }
+
+    bool reachable;
+    bool waitable;
+    bool setup_works;
+    bool done;
+    bool error;
+    int drains;
+    int setups;
+    int enables;
+    int disables;
+};
+
+static FakeChannels channels;
+static SSPDMA dma(&channels);
+
+// The DMA interrupt fires when the clock reaches interrupt_at, so it lands in the middle of SSPDMA::wait() like the real one
+static uint32_t now_us;
+static uint32_t interrupt_at;
+static bool interrupt_pending;
+static bool interrupt_fails;
+
+static void schedule_interrupt(uint32_t after_us, bool fails) {
+    interrupt_at = now_us + after_us;
+    interrupt_pending = true;
+    interrupt_fails = fails;
+}
+
+uint32_t us_ticker_read() {
+    now_us += 10;
+    if( interrupt_pending && now_us >= interrupt_at ){
+        interrupt_pending = false;
+        if( interrupt_fails )
+            channels.error = true;
+        else
+            channels.done = true;
+        dma.irq();
+    }
+    return now_us;
+}
+
+// Records what the completion callback was told
+class Listener {
+public:
+    Listener() : calls(0), last(0) {}
+    uint32_t done(uint32_t failed) { calls++; last = failed; return 0; }
+    int calls;
+    uint32_t last;
+};
+
+int main(){
+    Listener listener;
+    dma.attach_done(&listener, &Listener::done);
+    uint8_t tx[64] = { 0 };
+    uint8_t rx[64];
+
+    // A transfer that completes
+    schedule_interrupt(200, false);
+    CHECK( dma.transfer(tx, rx, sizeof(rx)) );
+    CHECK( channels.setups == 1 && channels.enables == 1 && channels.disables == 1 );
+    CHECK( channels.drains == 1 );              // before starting, for what polled transfers left behind
+    CHECK( listener.calls == 1 && listener.last == 0 );
+    CHECK( !dma.busy() && !dma.failed() );
+
+    // An interrupt for something else does not end ours
+    CHECK( dma.start(NULL, rx, sizeof(rx)) );
+    dma.irq();
+    CHECK( dma.busy() );
+    channels.done = true;
+    dma.irq();
+    CHECK( !dma.busy() && !dma.failed() );
+    CHECK( dma.wait() );
+    CHECK( listener.calls == 2 );
+
+    // The DMA reports an error : the caller is told to poll, and the port is drained for it
+    schedule_interrupt(200, true);
+    int drains = channels.drains;
+    CHECK( !dma.transfer(tx, NULL, sizeof(tx)) );
+    CHECK( dma.failed() && !dma.busy() );
+    CHECK( channels.drains == drains + 2 );
+    CHECK( listener.calls == 3 && listener.last == 1 );
+
+    // The interrupt never comes : the transfer is abandoned once the timeout is over, and polled instead
+    int disables = channels.disables;
+    uint32_t started = now_us;
+    CHECK( !dma.transfer(tx, rx, sizeof(rx)) );
+    CHECK( now_us - started > SPI_DMA_TIMEOUT_US );
+    CHECK( dma.failed() && !dma.busy() );
+    CHECK( channels.disables == disables + 1 );
+    CHECK( listener.calls == 3 );               // abandoning is not a completion
+
+    // ... and an interrupt that comes too late is ignored
+    channels.done = true;
+    dma.irq();
+    CHECK( listener.calls == 3 );
+
+    // The next transfer works again
+    schedule_interrupt(50, false);
+    CHECK( dma.transfer(tx, rx, sizeof(rx)) );
+    CHECK( !dma.failed() );
+
+    // Transfers left to the caller to poll, without touching the channels
+    int setups = channels.setups;
+    CHECK( !dma.transfer(tx, rx, SPI_DMA_MIN_LENGTH - 1) );     // too short to be worth it
+    CHECK( !dma.start(tx, rx, 0) );
+    CHECK( !dma.start(tx, rx, SPI_DMA_MAX_LENGTH + 1) );        // too long for one GPDMA transfer
+    channels.waitable = false;
+    CHECK( !dma.transfer(tx, rx, sizeof(rx)) );                 // the DMA interrupt may not be able to preempt us
+    channels.waitable = true;
+    channels.reachable = false;
+    CHECK( !dma.transfer(tx, rx, sizeof(rx)) );                 // buffers the DMA can't reach
+    channels.reachable = true;
+    CHECK( channels.setups == setups );
+
+    // The channels refuse the setup : nothing is started
+    channels.setup_works = false;
+    int enables = channels.enables;
+    CHECK( !dma.transfer(tx, rx, sizeof(rx)) );
+    CHECK( channels.enables == enables );
+    CHECK( !dma.busy() );
+    channels.setup_works = true;
+
+    // Only one transfer at a time
+    CHECK( dma.start(tx, rx, sizeof(rx)) );
+    CHECK( !dma.start(tx, rx, sizeof(rx)) );
+    dma.abort();
+    CHECK( !dma.busy() && dma.failed() );
+
+    printf("SSPDMATest: ok\n");
+    return 0;
+}
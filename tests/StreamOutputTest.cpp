@@ -0,0 +1,99 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// StreamOutput::printf formats piece by piece into a small buffer : check it prints what vsnprintf does,
+// and hands puts() a message in one piece when it fits, and whole lines when it does not
+
+#include "libs/StreamOutput.h"
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#define CHECK(condition) if( !(condition) ){ printf("StreamOutputTest: %s:%d: %s failed\n", __FILE__, __LINE__, #condition); exit(1); }
+
+class CaptureStream : public StreamOutput {
+    public:
+        CaptureStream() : calls(0) {}
+        int puts(const char* str){
+            this->pieces.push_back(str);
+            this->text += str;
+            this->calls++;
+            return strlen(str);
+        }
+        std::string text;
+        std::vector<std::string> pieces;
+        int calls;
+};
+
+// Print the same thing with StreamOutput::printf and vsnprintf, and compare
+static void compare(int line, const char* format, ...){
+    char expected[1024];
+    va_list args;
+    va_start(args, format);
+    int expected_length = vsnprintf(expected, sizeof(expected), format, args);
+    va_end(args);
+
+    CaptureStream stream;
+    va_start(args, format);
+    int length = stream.vprintf(format, args);
+    va_end(args);
+
+    if( stream.text != expected || length != expected_length ){
+        printf("StreamOutputTest: line %d: format \"%s\" gave \"%s\" ( %d ), vsnprintf gives \"%s\" ( %d )\n", line, format, stream.text.c_str(), length, expected, expected_length);
+        exit(1);
+    }
+}
+
+int main(){
+    compare(__LINE__, "ok\r\n");
+    compare(__LINE__, "");
+    compare(__LINE__, "ok T:%5.1f /%5.1f @%d\r\n", 210.04, 210.0, 255);
+    compare(__LINE__, "X:%1.4f Y:%1.4f Z:%1.4f\n", -12.5, 0.00001, 1e6);
+    compare(__LINE__, "%d %i %u %x %X %o %c %%", -42, 42, 4000000000u, 0xbeef, 0xBEEF, 8, 'z');
+    compare(__LINE__, "%ld %lu %lld %llu %zu %hhd %hd", -5l, 5ul, -1234567890123ll, 1234567890123ull, (size_t)77, 300, 70000);
+    compare(__LINE__, "%jd %td", (intmax_t)-9, (ptrdiff_t)9);
+    compare(__LINE__, "[%8s|%-8s|%.2s|%-*s|%*d|%-*d|%.*f]", "right", "left", "cut", 6, "star", 5, 42, -5, 42, 3, 3.14159);
+    compare(__LINE__, "[%+d|% d|%05d|%#x|%#o|%-+6d]", 5, 5, 42, 255, 8, 7);
+    compare(__LINE__, "%e %E %g %G %a", 123456.789, 0.000123, 1e-10, 1e20, 1.0);
+    compare(__LINE__, "%s and %s", "(null)", "text");
+    compare(__LINE__, "%p", (void*)0x1234);
+    compare(__LINE__, "a long string argument : %s\r\n", "0123456789012345678901234567890123456789012345678901234567890123456789012345678901234567890123456789");
+
+    // %n counts what was printed before it
+    CaptureStream counted;
+    int count = 0;
+    counted.printf("twelve chars%n!", &count);
+    CHECK( count == 12 );
+
+    // A usual reply goes to puts() in one piece
+    CaptureStream reply;
+    reply.printf("ok T:%5.1f /%5.1f B:%5.1f /%5.1f @%d\r\n", 210.0, 210.0, 60.0, 60.0, 127);
+    CHECK( reply.calls == 1 );
+
+    // A message longer than the buffer goes in whole lines
+    std::string big;
+    for( int i = 0; i < 40; i++ ){
+        char line[32];
+        snprintf(line, sizeof(line), "line number %d\r\n", i);
+        big += line;
+    }
+    CaptureStream lines;
+    lines.printf("%s", big.c_str());
+    CHECK( lines.text == big );
+    CHECK( lines.calls > 1 );
+    for( unsigned int i = 0; i < lines.pieces.size(); i++ ){
+        CHECK( lines.pieces[i].size() < STREAM_PRINTF_BUFFER_SIZE );
+        CHECK( lines.pieces[i][lines.pieces[i].size() - 1] == '\n' );
+    }
+
+    printf("StreamOutputTest: ok\n");
+    return 0;
+}
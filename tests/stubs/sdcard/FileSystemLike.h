@@ -0,0 +1,28 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MBED_FILESYSTEMLIKE_H
+#define MBED_FILESYSTEMLIKE_H
+
+// Stands in for mbed's FileSystemLike.h in host tests : a FATFileSystem that is never mounted, only its disk side is used
+
+#include <sys/types.h>
+
+namespace mbed {
+
+class FileHandle;
+class DirHandle;
+
+class FileSystemLike {
+public:
+    FileSystemLike(const char *name) {}
+    virtual ~FileSystemLike() {}
+};
+
+} // namespace mbed
+
+#endif
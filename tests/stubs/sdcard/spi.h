@@ -0,0 +1,27 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _SPI_H
+#define _SPI_H
+
+// Stands in for the firmware's spi.h in SDCardTest : the test defines these, and plays the card at the other end of the bus
+
+#include <stdint.h>
+#include <stddef.h>
+#include "PinNames.h"
+
+class SPI {
+public:
+    SPI(PinName mosi, PinName miso, PinName sclk) {}
+
+    void frequency(uint32_t) {}
+    uint8_t write(uint8_t);
+    void transfer(const uint8_t* tx, uint8_t* rx, int length);
+    bool can_DMA() { return false; }
+};
+
+#endif /* _SPI_H */
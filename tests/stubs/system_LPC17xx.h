@@ -0,0 +1,30 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SYSTEM_LPC17xx_H
+#define __SYSTEM_LPC17xx_H
+
+// Stands in for the firmware's system_LPC17xx.h in host tests : utils.cpp's watchdog reset is built, but never called
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t WDMOD;
+    uint32_t WDTC;
+    uint32_t WDFEED;
+    uint32_t WDTV;
+    uint32_t WDCLKSEL;
+} LPC_WDT_TypeDef;
+
+static LPC_WDT_TypeDef host_watchdog;
+#define LPC_WDT (&host_watchdog)
+
+static uint32_t SystemCoreClock = 100000000;
+
+static inline void NVIC_SystemReset() {}
+
+#endif